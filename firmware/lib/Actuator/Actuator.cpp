@@ -0,0 +1,107 @@
+/*
+ Actuator.cpp - Relay output with a shadow state and switch accounting.
+*/
+
+#include "Actuator.h"
+
+#include <Arduino.h>
+
+Actuator::Actuator(const char* name, uint8_t pin, uint32_t minOn, uint32_t minOff) {
+  _name = name;
+  _pin = pin;
+  _minOn = minOn;
+  _minOff = minOff;
+  _state = false;
+  _held = false;
+  _lastChange = 0;
+  _lastUpdate = 0;
+  _switches = 0;
+  _onTime = 0;
+  _onRemainder = 0;
+  _dutyStart = 0;
+  _dutyOn = 0;
+}
+
+void Actuator::begin(uint32_t now) {
+  pinMode(_pin, OUTPUT);
+  digitalWrite(_pin, LOW);
+  _state = false;
+  _held = false;
+  _lastUpdate = now;
+  _dutyStart = now;
+}
+
+bool Actuator::set(bool on, uint32_t now) {
+  if (on == _state)
+    return _state;
+  if (_held && now - _lastChange < (_state ? _minOn : _minOff))
+    return _state;
+  write(on, now);
+  return _state;
+}
+
+void Actuator::force(bool on, uint32_t now) {
+  if (on != _state)
+    write(on, now);
+}
+
+void Actuator::setMinimumTimes(uint32_t minOn, uint32_t minOff) {
+  _minOn = minOn;
+  _minOff = minOff;
+}
+
+bool Actuator::state() const {
+  return _state;
+}
+
+const char* Actuator::name() const {
+  return _name;
+}
+
+uint32_t Actuator::switches() const {
+  return _switches;
+}
+
+uint32_t Actuator::onTime(uint32_t now) {
+  account(now);
+  return _onTime;
+}
+
+uint8_t Actuator::duty(uint32_t now) {
+  account(now);
+  uint32_t elapsed = now - _dutyStart;
+  if (elapsed == 0)
+    return _state ? 100 : 0;
+  return (uint8_t)(((uint64_t)_dutyOn * 100 + elapsed / 2) / elapsed);
+}
+
+void Actuator::restartDuty(uint32_t now) {
+  account(now);
+  _dutyStart = now;
+  _dutyOn = 0;
+}
+
+void Actuator::restoreStats(uint32_t switches, uint32_t onTime) {
+  _switches = switches;
+  _onTime = onTime;
+}
+
+void Actuator::account(uint32_t now) {
+  uint32_t elapsed = now - _lastUpdate;
+  _lastUpdate = now;
+  if (!_state)
+    return;
+  _dutyOn += elapsed;
+  _onRemainder += elapsed;
+  _onTime += _onRemainder / 1000;
+  _onRemainder %= 1000;
+}
+
+void Actuator::write(bool on, uint32_t now) {
+  account(now);
+  digitalWrite(_pin, on ? HIGH : LOW);
+  _state = on;
+  _held = true;
+  _lastChange = now;
+  _switches++;
+}
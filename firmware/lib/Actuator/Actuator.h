@@ -0,0 +1,91 @@
+/*
+ Actuator.h - Relay output with a shadow state and switch accounting.
+
+ The state of the output is kept in RAM, so deciding whether to write and
+ reporting the state never reads the pin back, and the pin is only written
+ when the state changes. A change requested before the output has been in
+ its current state for the minimum on or off time is held back; callers
+ request the state they want on every control step and the change goes
+ through once the minimum time has passed. force() skips the minimum times
+ for stops and restores.
+
+ Every actuator counts its switches and its total on-time since boot, and
+ the duty cycle since the last restartDuty().
+*/
+
+#ifndef Actuator_h
+#define Actuator_h
+
+#include <stdint.h>
+
+class Actuator {
+  public:
+    /**
+     * @param minOn minimum time the output stays on once switched on, in ms
+     * @param minOff minimum time the output stays off once switched off, in ms
+     */
+    Actuator(const char* name, uint8_t pin, uint32_t minOn = 0, uint32_t minOff = 0);
+
+    /**
+     * Configures the pin as an output and drives it low. The minimum off
+     * time does not apply to the first switch on.
+     */
+    void begin(uint32_t now);
+
+    /**
+     * Requests a state, subject to the minimum on and off times.
+     *
+     * @param now current time, in ms
+     * @return the state of the output after the call
+     */
+    bool set(bool on, uint32_t now);
+
+    /**
+     * Sets the state right away, whatever the minimum times.
+     */
+    void force(bool on, uint32_t now);
+
+    void setMinimumTimes(uint32_t minOn, uint32_t minOff);
+
+    bool        state() const;
+    const char* name() const;
+
+    uint32_t switches() const;
+
+    /**
+     * @return the total time the output was on since boot, in s
+     */
+    uint32_t onTime(uint32_t now);
+
+    /**
+     * @return the percentage of time the output was on since the last
+     * restartDuty()
+     */
+    uint8_t duty(uint32_t now);
+    void    restartDuty(uint32_t now);
+
+    /**
+     * Sets the counters kept across a warm reset, see RtcState.
+     */
+    void restoreStats(uint32_t switches, uint32_t onTime);
+
+  private:
+    const char* _name;
+    uint8_t     _pin;
+    bool        _state;
+    bool        _held;          // minimum times apply to the next change
+    uint32_t    _minOn;         // in ms
+    uint32_t    _minOff;        // in ms
+    uint32_t    _lastChange;    // in ms
+    uint32_t    _lastUpdate;    // in ms, on-time accounted up to here
+    uint32_t    _switches;
+    uint32_t    _onTime;        // in s
+    uint32_t    _onRemainder;   // in ms, below one second
+    uint32_t    _dutyStart;     // in ms
+    uint32_t    _dutyOn;        // in ms
+
+    void account(uint32_t now);
+    void write(bool on, uint32_t now);
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ Aggregator.cpp - Windowed statistics of the sensor readings.
+*/
+
+#include "Aggregator.h"
+
+// Square root rounded to the nearest integer, bit by bit.
+static uint32_t isqrt(uint32_t v) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > v)
+    bit >>= 2;
+  while (bit) {
+    if (v >= root + bit) {
+      v -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  // v is now the remainder, value - root^2
+  return v > root ? root + 1 : root;
+}
+
+void RunningStats::reset() {
+  count = 0;
+  min = 0;
+  max = 0;
+  sum = 0;
+  squares = 0;
+}
+
+void RunningStats::add(int16_t value) {
+  if (count == 0 || value < min)
+    min = value;
+  if (count == 0 || value > max)
+    max = value;
+
+  count++;
+  sum += value;
+  squares += (int32_t)value * value;
+}
+
+int16_t RunningStats::mean() const {
+  if (count == 0)
+    return 0;
+  int32_t half = count / 2;
+  return (sum >= 0 ? sum + half : sum - half) / (int32_t)count;
+}
+
+// (n sum(x^2) - sum(x)^2) / (n (n - 1)), exact up to the last division.
+uint32_t RunningStats::variance() const {
+  if (count < 2)
+    return 0;
+  int64_t n = count;
+  return (n * squares - (int64_t)sum * sum) / (n * (n - 1));
+}
+
+int16_t RunningStats::stddev() const {
+  return isqrt(variance());
+}
+
+WindowAggregator::WindowAggregator(uint32_t windowSeconds) {
+  _window = windowSeconds * 1000;
+  restart();
+}
+
+void WindowAggregator::add(uint32_t now, int16_t t, int16_t h, uint8_t actuators) {
+  if (samples == 0)
+    _start = now;
+  samples++;
+
+  if (t != AGGREGATOR_NO_READING)
+    temperature.add(t);
+  if (h != AGGREGATOR_NO_READING)
+    humidity.add(h);
+
+  for (uint8_t i = 0; i < AGGREGATOR_ACTUATORS; i++)
+    if (actuators & (1 << i))
+      _on[i]++;
+}
+
+bool WindowAggregator::ready(uint32_t now) const {
+  return samples != 0 && now - _start >= _window;
+}
+
+void WindowAggregator::restart() {
+  temperature.reset();
+  humidity.reset();
+  samples = 0;
+  _start = 0;
+  for (uint8_t i = 0; i < AGGREGATOR_ACTUATORS; i++)
+    _on[i] = 0;
+}
+
+uint32_t WindowAggregator::window() const {
+  return _window / 1000;
+}
+
+uint8_t WindowAggregator::duty(uint8_t actuator) const {
+  if (samples == 0)
+    return 0;
+  return (_on[actuator] * 100 + samples / 2) / samples;
+}
@@ -0,0 +1,75 @@
+/*
+ Aggregator.h - Windowed statistics of the sensor readings.
+
+ Keeps count, min, max, mean and variance of temperature and humidity, and
+ the duty cycle of the actuators, over a fixed time window, in constant
+ memory. The owner checks ready() after every add() and publishes and
+ restarts the window when it closes.
+
+ Readings are integers in 0.1 units, so the sums of the values and of
+ their squares are exact and the variance comes from them at the end of
+ the window, without the cancellation a float sum of squares would
+ suffer.
+*/
+
+#ifndef Aggregator_h
+#define Aggregator_h
+
+#include <stdint.h>
+
+#define AGGREGATOR_ACTUATORS  4           // flag bits 0..3, see STATUS_FLAG_* in StatusSnapshot.h
+#define AGGREGATOR_NO_READING INT16_MIN
+
+struct RunningStats {
+  uint32_t  count;
+  int16_t   min;
+  int16_t   max;
+  int32_t   sum;
+  int64_t   squares;  // sum of the squared values
+
+  void      reset();
+  void      add(int16_t value);
+  int16_t   mean() const;       // rounded, in the units of the values
+  uint32_t  variance() const;   // in squared units
+  int16_t   stddev() const;     // rounded
+};
+
+class WindowAggregator {
+  public:
+    WindowAggregator(uint32_t windowSeconds);
+
+    /**
+     * Adds one sample taken at now (in ms), temperature and humidity in 0.1
+     * units. AGGREGATOR_NO_READING readings only count towards the actuator
+     * duty cycle.
+     */
+    void add(uint32_t now, int16_t temperature, int16_t humidity, uint8_t actuators);
+
+    /**
+     * @return true once the window that started with the first sample is over
+     */
+    bool ready(uint32_t now) const;
+
+    /**
+     * Clears the statistics, the next add() opens a new window.
+     */
+    void restart();
+
+    uint32_t  window() const;
+
+    /**
+     * @return the fraction of samples with the actuator on, in percent
+     */
+    uint8_t   duty(uint8_t actuator) const;
+
+    RunningStats  temperature;
+    RunningStats  humidity;
+    uint32_t      samples;
+
+  private:
+    uint32_t  _window;      // in ms
+    uint32_t  _start;       // in ms
+    uint32_t  _on[AGGREGATOR_ACTUATORS];
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ CommandDispatcher.cpp - Routes ESPID/set/... messages to their handlers.
+*/
+
+#include "CommandDispatcher.h"
+
+#include <string.h>
+
+#define FNV_OFFSET  2166136261UL
+#define FNV_PRIME   16777619UL
+
+CommandDispatcher::CommandDispatcher() {
+  _prefix[0] = '\0';
+  _prefixLength = 0;
+  _count = 0;
+  memset(_table, 0, sizeof(_table));
+}
+
+void CommandDispatcher::begin(const char* id) {
+  uint8_t n = 0;
+  while (*id && n < COMMAND_PREFIX_SIZE - 6)
+    _prefix[n++] = *id++;
+  memcpy(_prefix + n, "/set/", 6);
+  _prefixLength = n + 5;
+}
+
+uint32_t CommandDispatcher::hash(const char* s) {
+  uint32_t h = FNV_OFFSET;
+  while (*s) {
+    h ^= (uint8_t)*s++;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+bool CommandDispatcher::add(const char* suffix, CommandHandler handler) {
+  if (_count >= COMMAND_TABLE_SIZE - 1)
+    return false;
+
+  uint32_t h = hash(suffix);
+  uint8_t i = h & (COMMAND_TABLE_SIZE - 1);
+  while (_table[i].suffix) {
+    if (_table[i].hash == h && strcmp(_table[i].suffix, suffix) == 0)
+      return false;
+    i = (i + 1) & (COMMAND_TABLE_SIZE - 1);
+  }
+
+  _table[i].suffix = suffix;
+  _table[i].handler = handler;
+  _table[i].hash = h;
+  _count++;
+  return true;
+}
+
+bool CommandDispatcher::dispatch(const char* topic, const uint8_t* payload, uint16_t length) const {
+  if (strncmp(topic, _prefix, _prefixLength) != 0)
+    return false;
+
+  const char* suffix = topic + _prefixLength;
+  uint32_t h = hash(suffix);
+  // The table is never full, so an empty slot always ends the probe.
+  uint8_t i = h & (COMMAND_TABLE_SIZE - 1);
+  while (_table[i].suffix) {
+    if (_table[i].hash == h && strcmp(_table[i].suffix, suffix) == 0) {
+      _table[i].handler(payload, length);
+      return true;
+    }
+    i = (i + 1) & (COMMAND_TABLE_SIZE - 1);
+  }
+  return false;
+}
+
+const char* CommandDispatcher::prefix() const {
+  return _prefix;
+}
+
+bool parseInt(const uint8_t* payload, uint16_t length, int32_t& value) {
+  uint16_t i = 0;
+  bool negative = false;
+  if (length > 0 && (payload[0] == '-' || payload[0] == '+')) {
+    negative = payload[0] == '-';
+    i++;
+  }
+  if (i == length)
+    return false;
+
+  int32_t v = 0;
+  for (; i < length; i++) {
+    uint8_t d = payload[i] - '0';
+    if (d > 9 || v > (2147483647 - d) / 10)
+      return false;
+    v = v * 10 + d;
+  }
+  value = negative ? -v : v;
+  return true;
+}
+
+bool parseDeci(const uint8_t* payload, uint16_t length, int32_t& value) {
+  uint16_t i = 0;
+  bool negative = false;
+  if (length > 0 && (payload[0] == '-' || payload[0] == '+')) {
+    negative = payload[0] == '-';
+    i++;
+  }
+
+  int32_t v = 0;
+  uint16_t digits = 0;
+  for (; i < length && payload[i] != '.'; i++, digits++) {
+    uint8_t d = payload[i] - '0';
+    if (d > 9 || v > (214748363 - d) / 10)   // room for the tenths below
+      return false;
+    v = v * 10 + d;
+  }
+  v *= 10;
+
+  if (i < length) {
+    i++;    // '.'
+    for (uint16_t decimals = 0; i < length; i++, decimals++, digits++) {
+      uint8_t d = payload[i] - '0';
+      if (d > 9)
+        return false;
+      if (decimals == 0)
+        v += d;
+      else if (decimals == 1 && d >= 5)
+        v++;
+    }
+  }
+  if (digits == 0)
+    return false;
+
+  value = negative ? -v : v;
+  return true;
+}
+
+bool parseFloat(const uint8_t* payload, uint16_t length, float& value) {
+  uint16_t i = 0;
+  bool negative = false;
+  if (length > 0 && (payload[0] == '-' || payload[0] == '+')) {
+    negative = payload[0] == '-';
+    i++;
+  }
+
+  int32_t mantissa = 0;
+  uint16_t digits = 0;      // all digits seen
+  uint8_t significant = 0;  // digits after the leading zeros
+  uint16_t decimals = 0;
+  bool point = false;
+  for (; i < length; i++) {
+    if (payload[i] == '.' && !point) {
+      point = true;
+      continue;
+    }
+    uint8_t d = payload[i] - '0';
+    if (d > 9)
+      return false;
+    digits++;
+    if (mantissa != 0 || d != 0)
+      significant++;
+    if (significant > 9)
+      return false;
+    mantissa = mantissa * 10 + d;
+    if (point)
+      decimals++;
+  }
+  if (digits == 0)
+    return false;
+
+  float v = mantissa;
+  while (decimals--)
+    v /= 10;
+  value = negative ? -v : v;
+  return true;
+}
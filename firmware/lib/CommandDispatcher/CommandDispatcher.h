@@ -0,0 +1,91 @@
+/*
+ CommandDispatcher.h - Routes ESPID/set/... messages to their handlers.
+
+ The "ESPID/set/" prefix is built once by begin(). Commands are stored in a
+ small open addressing table keyed on an FNV-1a hash of the topic suffix,
+ so dispatch() walks the topic once to check the prefix and hash the
+ suffix, then confirms the match with one string compare. Nothing is
+ allocated and nothing is copied: handlers get the payload straight from
+ the MQTT client buffer, which is not NUL terminated, and use the parse
+ functions below on it.
+*/
+
+#ifndef CommandDispatcher_h
+#define CommandDispatcher_h
+
+#include <stdint.h>
+
+#ifndef COMMAND_TABLE_SIZE
+#define COMMAND_TABLE_SIZE 64   // power of two, keep it at least twice the command count
+#endif
+
+#define COMMAND_PREFIX_SIZE 20  // "ESPID/set/" with an id of up to 15 characters
+
+typedef void (*CommandHandler)(const uint8_t* payload, uint16_t length);
+
+class CommandDispatcher {
+  public:
+    CommandDispatcher();
+
+    /**
+     * Builds the "<id>/set/" prefix the commands are matched under.
+     */
+    void begin(const char* id);
+
+    /**
+     * Registers handler for "<id>/set/<suffix>". suffix must stay valid,
+     * string literals are expected.
+     *
+     * @return false if the table is full or suffix is already registered
+     */
+    bool add(const char* suffix, CommandHandler handler);
+
+    /**
+     * Calls the handler registered for topic.
+     *
+     * @return false if topic does not match any command
+     */
+    bool dispatch(const char* topic, const uint8_t* payload, uint16_t length) const;
+
+    const char* prefix() const;
+
+  private:
+    struct Entry {
+      const char*     suffix;
+      CommandHandler  handler;
+      uint32_t        hash;
+    };
+
+    static uint32_t hash(const char* s);
+
+    char      _prefix[COMMAND_PREFIX_SIZE];
+    uint8_t   _prefixLength;
+    uint8_t   _count;
+    Entry     _table[COMMAND_TABLE_SIZE];
+};
+
+/**
+ * Parses an optionally signed decimal integer that fills the whole payload.
+ *
+ * @return false if the payload is empty, has any other character or overflows
+ */
+bool parseInt(const uint8_t* payload, uint16_t length, int32_t& value);
+
+/**
+ * Parses a decimal number with an optional fraction ("25", "-3.5", "85.25")
+ * into tenths, the unit of the setpoints: digits after the first decimal
+ * round half away from zero.
+ *
+ * @return false if the payload is not a number or overflows
+ */
+bool parseDeci(const uint8_t* payload, uint16_t length, int32_t& value);
+
+/**
+ * Parses a decimal number with up to 9 significant digits and no exponent
+ * ("0.0005", "-2.5"), for values finer than tenths such as controller gains.
+ *
+ * @return false if the payload is not a number or has too many digits
+ */
+bool parseFloat(const uint8_t* payload, uint16_t length, float& value);
+
+#endif
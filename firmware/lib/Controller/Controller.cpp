@@ -0,0 +1,140 @@
+/*
+ Controller.cpp - Chamber control logic.
+*/
+
+#include "Controller.h"
+
+#include <Psychrometrics.h>
+
+Controller::Controller(SystemData& data) : _data(data) {
+  setReadings(0, 0);
+  humidifierPulse = false;
+  _pulsePeriod = 0;
+  _pulseActiveTime = 0;
+  resetHeater();
+}
+
+void Controller::processSensors(uint32_t now, int16_t t, int16_t h) {
+  if (t != SENSOR_NO_READING) {
+    _filteredTemperature = _temperatureFilter.apply(extendReading(t), now, _data.temperatureFilter);
+    temperature = roundReading(_filteredTemperature);
+  }
+
+  if (h != SENSOR_NO_READING) {
+    _filteredHumidity = _humidityFilter.apply(extendReading(h), now, _data.humidityFilter);
+    humidity    = roundReading(_filteredHumidity);
+  }
+}
+
+void Controller::setReadings(int16_t t, uint16_t h) {
+  temperature = t;
+  humidity = h;
+  _filteredTemperature = extendReading(t);
+  _filteredHumidity = extendReading(h);
+  _temperatureFilter.reset();
+  _humidityFilter.reset();
+}
+
+float Controller::temperatureCelsius() const {
+  return _filteredTemperature / (10.0f * (1 << FILTER_FRACTION_BITS));
+}
+
+float Controller::relativeHumidity() const {
+  return _filteredHumidity / (10.0f * (1 << FILTER_FRACTION_BITS));
+}
+
+bool Controller::processHeater(uint32_t now) {
+  bool on;
+  if (_data.heaterKp == 0 && _data.heaterKi == 0)
+    on = _filteredTemperature < extendReading(_data.setTemperature);
+  else
+    on = processHeaterPid(now);
+  model.update(now, temperatureCelsius(), on);
+  return on;
+}
+
+bool Controller::processHeaterPid(uint32_t now) {
+  float dt = _heaterStarted ? (now - _lastHeater) / 1000.0f : 0;
+  // The model's steady state duty preloads the output when the loop starts,
+  // so a cold chamber does not wait hours for the integral to wind up. After
+  // that the integral takes out every change of the feed-forward: setpoint
+  // steps behaved better in simulation with the PID alone. Should the fit
+  // stop making sense, the integral takes the feed-forward back; after a
+  // warm reset the saved one is held until the new fit is valid.
+  float setpoint = _data.setTemperature / 10.0f;
+  float feedForward = 0;
+  if (model.valid()) {
+    feedForward = model.feedForward(setpoint);
+    if (_feedForward)
+      heaterPid.integral -= feedForward - _lastFeedForward;
+    else if (_heaterStarted)
+      heaterPid.integral -= feedForward;
+    _feedForward = true;
+    _resumed = false;
+    _lastFeedForward = feedForward;
+  } else if (_resumed) {
+    feedForward = _lastFeedForward;
+  } else if (_feedForward) {
+    heaterPid.integral += _lastFeedForward;
+    _feedForward = false;
+    _lastFeedForward = 0;
+  }
+  heaterPid.update(_data.heaterKp, _data.heaterKi, _data.heaterKd,
+                   setpoint, temperatureCelsius(), dt, feedForward);
+  _lastHeater = now;
+
+  uint32_t window = _data.heaterWindow * 1000;
+  if (!_heaterStarted || now - _windowStart >= window) {
+    _windowStart = now;
+    _onTime = heaterPid.output * window;
+  }
+  _heaterStarted = true;
+  return now - _windowStart < _onTime;
+}
+
+void Controller::resetHeater() {
+  heaterPid.reset();
+  model.restart();
+  _heaterStarted = false;
+  _feedForward = false;
+  _resumed = false;
+  _lastFeedForward = 0;
+  _lastHeater = 0;
+  _windowStart = 0;
+  _onTime = 0;
+}
+
+float Controller::heaterFeedForward() const {
+  return _lastFeedForward;
+}
+
+void Controller::resumeHeater(float integral, float feedForward) {
+  heaterPid.integral = integral;
+  _feedForward = feedForward != 0;
+  _resumed = _feedForward;
+  _lastFeedForward = feedForward;
+}
+
+bool Controller::processHumidifier(uint32_t epoch) {
+  if (_data.humidifierPeriod != _pulsePeriod || _data.humidifierActiveTime != _pulseActiveTime) {
+    _pulsePeriod = _data.humidifierPeriod;
+    _pulseActiveTime = _data.humidifierActiveTime;
+    _pulse.clear();
+    if (_pulsePeriod != 0 && _pulseActiveTime != 0)
+      _pulse.add(_pulsePeriod * 60, 0, _pulseActiveTime < _pulsePeriod * 60 ? _pulseActiveTime : _pulsePeriod * 60);
+  }
+
+  humidifierPulse = _pulse.active(epoch) || humidifierSchedule.active(epoch);
+  if (humidifierPulse)
+    return true;
+
+  return _filteredHumidity < extendReading(humiditySetpoint());
+}
+
+// Mushrooms dry out by the deficit, not by the relative humidity: the same
+// %RH pulls more water out of the substrate when the chamber is warmer.
+uint16_t Controller::humiditySetpoint() const {
+  if (_data.setVpd == 0)
+    return _data.setHumidity;
+  return humidityForDeficit(temperature, _data.setVpd);
+}
@@ -0,0 +1,163 @@
+/*
+ Controller.h - Chamber control logic.
+
+ Filters the sensor readings and decides the heater and humidifier outputs
+ from the settings in SystemData. It has no Arduino dependencies so the same
+ code runs on the ESP8266 and in the host simulator (tools/thermal_sim).
+
+ Readings and setpoints are integers in 0.1 C and 0.1 %RH from the sensor
+ to the outputs. The filters keep FILTER_FRACTION_BITS more bits, which the
+ on/off decisions compare with, so they do not dither on the 0.1 steps;
+ only the PID and the thermal model work in float, once per control step.
+*/
+
+#ifndef Controller_h
+#define Controller_h
+
+#include <stdint.h>
+#include "SystemData.h"
+#include "Pid.h"
+#include "ThermalModel.h"
+#include "SensorFilter.h"
+#include <OutputSchedule.h>
+
+// Sensor filter coefficients for a new node, in the units of the
+// configuration, see FilterSettings.
+#ifndef TEMPERATURE_SMOOTHING_CONSTANT
+#define TEMPERATURE_SMOOTHING_CONSTANT  0.4
+#endif
+#ifndef HUMIDITY_SMOOTHING_CONSTANT
+#define HUMIDITY_SMOOTHING_CONSTANT     0.8
+#endif
+#define DEFAULT_TEMPERATURE_MAX_RATE    0.1   // in Celsius per second
+#define DEFAULT_HUMIDITY_MAX_RATE       2     // in %RH per second
+#define DEFAULT_SENSOR_PROCESS_NOISE    0.05  // per second, for a KalmanFilter stage
+
+#ifndef SENSOR_MEDIAN_SIZE
+#define SENSOR_MEDIAN_SIZE  3
+#endif
+
+#define SENSOR_NO_READING   INT16_MIN   // for processSensors(), a failed read
+
+// Both channels run through this chain, with the settings of their own.
+typedef FilterChain<MedianFilter<SENSOR_MEDIAN_SIZE>, RateLimiter, EmaFilter> SensorChannel;
+
+// Heater PID gains and window for a new node, see SystemData.
+#define DEFAULT_HEATER_KP       0.5
+#define DEFAULT_HEATER_KI       0.0001
+#define DEFAULT_HEATER_KD       0
+#define DEFAULT_HEATER_WINDOW   300   // in s
+
+// A relay stays at least this long in a state before it may switch again,
+// see Actuator. The simulator drives its outputs with the same times.
+#define HEATER_MIN_ON       10000 // in ms
+#define HEATER_MIN_OFF      10000 // in ms
+#define HUMIDIFIER_MIN_ON   5000  // in ms
+#define HUMIDIFIER_MIN_OFF  5000  // in ms
+
+class Controller {
+  public:
+    Controller(SystemData& data);
+
+    /**
+     * Feeds a new sensor reading into the filters, with the coefficients
+     * of temperatureFilter and humidityFilter in the settings.
+     * SENSOR_NO_READING values are ignored.
+     *
+     * @param now current time, in ms
+     * @param t temperature, in 0.1 C
+     * @param h humidity, in 0.1 %RH
+     */
+    void processSensors(uint32_t now, int16_t t, int16_t h);
+
+    /**
+     * Runs the heater PID and turns its output into a time-proportioned
+     * on/off signal: the heater is on for the first output * heaterWindow
+     * seconds of every window, so the relay switches at most twice per
+     * window. The on-time is fixed when a window starts. Once the thermal
+     * model is valid, the PID starts from the duty it predicts for the
+     * setpoint. With heaterKp and heaterKi both 0 this is the on/off
+     * control of older versions; the model is identified in both cases.
+     *
+     * @param now current time, in ms
+     * @return true if the heater must be on
+     */
+    bool processHeater(uint32_t now);
+
+    /**
+     * Restarts the PID and the window, call it when a run starts. The
+     * thermal model keeps its fit.
+     */
+    void resetHeater();
+
+    /**
+     * @return the model feed-forward the PID runs with, 0 if none; saved
+     * with heaterPid.integral across a warm reset
+     */
+    float heaterFeedForward() const;
+
+    /**
+     * Restores the PID after a warm reset. The model starts over, so
+     * feedForward is held until it is valid again.
+     */
+    void resumeHeater(float integral, float feedForward);
+
+    /**
+     * Runs the humidifier on its schedule: the periodic pulse of the
+     * settings (humidifierPeriod, humidifierActiveTime), aligned to the
+     * clock, and the windows of humidifierSchedule. Outside of them it
+     * falls back to the humidity error.
+     *
+     * @param epoch local time in seconds since Jan. 1, 1970
+     * @return true if the humidifier must be on
+     */
+    bool processHumidifier(uint32_t epoch);
+
+    /**
+     * @return the humidity the humidifier aims at, in 0.1 %RH: setHumidity,
+     * or with a VPD setpoint the humidity that gives that deficit at the
+     * current temperature
+     */
+    uint16_t humiditySetpoint() const;
+
+    /**
+     * Sets the filtered values, as after a warm reset; the filters start
+     * over with the next reading.
+     */
+    void setReadings(int16_t t, uint16_t h);
+
+    /**
+     * @return the filtered readings in Celsius and %RH at the resolution of
+     * the filters, for callers that want floats
+     */
+    float temperatureCelsius() const;
+    float relativeHumidity() const;
+
+    int16_t   temperature;      // filtered, in 0.1 C
+    uint16_t  humidity;         // filtered, in 0.1 %RH
+    bool      humidifierPulse;  // true while a scheduled window is on
+    OutputSchedule  humidifierSchedule;
+    Pid       heaterPid;
+    ThermalModel  model;
+
+  private:
+    SystemData& _data;
+    bool        _heaterStarted;
+    bool        _feedForward;   // model feed-forward in use
+    bool        _resumed;       // _lastFeedForward held since a warm reset
+    float       _lastFeedForward;
+    uint32_t    _lastHeater;    // in ms
+    uint32_t    _windowStart;   // in ms
+    uint32_t    _onTime;        // in the current window, in ms
+    OutputSchedule  _pulse;     // the periodic pulse of the settings
+    uint32_t    _pulsePeriod;   // settings _pulse was built from
+    uint32_t    _pulseActiveTime;
+    SensorChannel _temperatureFilter;
+    SensorChannel _humidityFilter;
+    int32_t     _filteredTemperature;   // filter output, see extendReading()
+    int32_t     _filteredHumidity;
+
+    bool processHeaterPid(uint32_t now);
+};
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ Pid.cpp - PID controller with a 0..1 output.
+*/
+
+#include "Pid.h"
+
+Pid::Pid() {
+  reset();
+}
+
+float Pid::update(float kp, float ki, float kd, float setpoint, float measurement, float dt,
+                  float feedForward) {
+  float error = setpoint - measurement;
+  float p = feedForward + kp * error;
+  float d = 0;
+
+  if (_started && dt > 0) {
+    d = -kd * (measurement - _lastMeasurement) / dt;
+
+    float u = p + integral + d;
+    if (!(u >= 1 && error > 0) && !(u <= 0 && error < 0))
+      integral += ki * error * dt;
+    if (integral > 1)
+      integral = 1;
+    else if (integral < -1)
+      integral = -1;
+  }
+  _lastMeasurement = measurement;
+  _started = true;
+
+  output = p + integral + d;
+  if (output > 1)
+    output = 1;
+  else if (output < 0)
+    output = 0;
+  return output;
+}
+
+void Pid::reset() {
+  integral = 0;
+  output = 0;
+  _lastMeasurement = 0;
+  _started = false;
+}
@@ -0,0 +1,45 @@
+/*
+ Pid.h - PID controller with a 0..1 output.
+
+ The derivative acts on the measurement rather than on the error, so a
+ setpoint change does not kick the output. The integral is clamped to the
+ output range and is not increased while the output is saturated in the
+ direction of the error (conditional integration), so it does not wind up
+ while the heater is at full power during warm-up.
+
+ The integral is kept between -1 and 1 so it can also take back a
+ feed-forward term that is too high.
+*/
+
+#ifndef Pid_h
+#define Pid_h
+
+#include <stdint.h>
+
+class Pid {
+  public:
+    Pid();
+
+    /**
+     * Runs one step.
+     *
+     * @param dt time since the previous step, in s. The first step after
+     * reset() only uses the proportional term.
+     * @param feedForward added to the output, the PID terms then only
+     * correct what it gets wrong
+     * @return the output, between 0 and 1
+     */
+    float update(float kp, float ki, float kd, float setpoint, float measurement, float dt,
+                 float feedForward = 0);
+
+    void reset();
+
+    float   integral;       // integral term, in output units
+    float   output;
+
+  private:
+    float   _lastMeasurement;
+    bool    _started;
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ SensorFilter.cpp - Fixed-size filter chains for the sensor channels.
+*/
+
+#include "SensorFilter.h"
+
+// The first reading passes as is in every stage, so the output does not
+// ramp up from 0 after a boot.
+
+// v + weight * (x - v), weight in 1/2^15.
+static int32_t blend(int32_t v, int32_t x, uint32_t weight) {
+  return v + (int32_t)(((int64_t)(x - v) * weight + (1 << 14)) >> 15);
+}
+
+int32_t RateLimiter::apply(int32_t x, uint32_t now, const FilterSettings& s) {
+  if (_started && s.maxRate > 0) {
+    uint32_t dt = now - _last;
+    if (dt > FILTER_MAX_GAP)
+      dt = FILTER_MAX_GAP;
+    // 0.01 units per s times ms, in 0.1 units with FILTER_FRACTION_BITS
+    // more: maxRate * dt * 256 / 10000.
+    int32_t limit = (uint32_t)s.maxRate * dt / 625 * 16;
+    if (x > _value + limit)
+      x = _value + limit;
+    else if (x < _value - limit)
+      x = _value - limit;
+  }
+  _started = true;
+  _value = x;
+  _last = now;
+  return x;
+}
+
+int32_t EmaFilter::apply(int32_t x, uint32_t, const FilterSettings& s) {
+  if (_started)
+    _value = blend(_value, x, s.smoothing);
+  else
+    _value = x;
+  _started = true;
+  return _value;
+}
+
+int32_t KalmanFilter::apply(int32_t x, uint32_t now, const FilterSettings& s) {
+  if (!_started) {
+    _started = true;
+    _value = x;
+    _variance = FILTER_NOISE_ONE;
+    _last = now;
+    return x;
+  }
+
+  uint64_t variance = _variance + (uint64_t)s.processNoise * (now - _last) / 1000;
+  _variance = variance < FILTER_MAX_VARIANCE ? variance : FILTER_MAX_VARIANCE;
+  _last = now;
+  uint32_t gain = ((uint64_t)_variance << 15) / (_variance + FILTER_NOISE_ONE);
+  _value = blend(_value, x, gain);
+  _variance = ((uint64_t)_variance * ((1UL << 15) - gain)) >> 15;
+  return _value;
+}
@@ -0,0 +1,166 @@
+/*
+ SensorFilter.h - Fixed-size filter chains for the sensor channels.
+
+ A chain is put together at compile time from stages that each take a
+ reading and return the filtered value:
+
+   MedianFilter<N>   median of the last N readings; a single bad frame
+                     that passed the checksum never reaches the output
+   RateLimiter       limits the change to maxRate per second
+   EmaFilter         exponential moving average with weight smoothing
+   KalmanFilter      1-D random walk Kalman filter, the gain follows the
+                     time between readings; noise is processNoise per s
+                     over a measurement variance of 1
+
+ for example FilterChain<MedianFilter<3>, RateLimiter, EmaFilter>. Every
+ stage keeps its state inline, so a chain is a plain object with no heap
+ use. The coefficients are not part of the chain but a FilterSettings
+ passed on every reading, so they can be changed at run time (they live in
+ SystemData) without touching the filter state.
+
+ The chain is fixed point: the ESP8266 has no FPU, so every float
+ operation would be a call into the software float library. Values are
+ readings in the units the DHT22 sends, 0.1 C or 0.1 %RH, with
+ FILTER_FRACTION_BITS more bits (extendReading()), so that small weights
+ still move the output and the controller compares against setpoints
+ without the 0.1 steps. The coefficients are scaled integers, see
+ FilterSettings and the FILTER_* macros that convert from the float values
+ of the configuration.
+*/
+
+#ifndef SensorFilter_h
+#define SensorFilter_h
+
+#include <stdint.h>
+
+#define FILTER_FRACTION_BITS  8
+#define FILTER_SMOOTHING_ONE  32768     // smoothing of 1
+#define FILTER_NOISE_ONE      65536UL   // process noise of 1, also the measurement variance
+#define FILTER_MAX_GAP        400000    // in ms, a longer gap limits the rate as if it were this long
+#define FILTER_MAX_VARIANCE   (1000 * FILTER_NOISE_ONE)
+
+// From the float coefficients of the configuration; constant arguments are
+// folded by the compiler.
+#define FILTER_SMOOTHING(x)   ((uint16_t)((x) * FILTER_SMOOTHING_ONE + 0.5))
+#define FILTER_RATE(x)        ((uint16_t)((x) * 100 + 0.5))
+#define FILTER_NOISE(x)       ((uint32_t)((x) * FILTER_NOISE_ONE + 0.5))
+
+inline int32_t extendReading(int16_t x) {
+  return (int32_t)x << FILTER_FRACTION_BITS;
+}
+
+/**
+ * @return a filter value rounded to the reading units
+ */
+inline int16_t roundReading(int32_t v) {
+  return (v + (1 << (FILTER_FRACTION_BITS - 1))) >> FILTER_FRACTION_BITS;
+}
+
+struct FilterSettings {
+  uint16_t  smoothing;      // EMA weight of a new reading, 1 to FILTER_SMOOTHING_ONE
+  uint16_t  maxRate;        // in 0.01 units per second, 0 disables the limiter
+  uint32_t  processNoise;   // Kalman variance added per second, in 1/FILTER_NOISE_ONE
+};
+
+class RateLimiter {
+  public:
+    RateLimiter() { reset(); }
+    void  reset() { _started = false; }
+    int32_t apply(int32_t x, uint32_t now, const FilterSettings& s);
+
+  private:
+    bool      _started;
+    int32_t   _value;
+    uint32_t  _last;    // in ms
+};
+
+class EmaFilter {
+  public:
+    EmaFilter() { reset(); }
+    void  reset() { _started = false; }
+    int32_t apply(int32_t x, uint32_t now, const FilterSettings& s);
+
+  private:
+    bool      _started;
+    int32_t   _value;
+};
+
+class KalmanFilter {
+  public:
+    KalmanFilter() { reset(); }
+    void  reset() { _started = false; }
+    int32_t apply(int32_t x, uint32_t now, const FilterSettings& s);
+
+  private:
+    bool      _started;
+    int32_t   _value;
+    uint32_t  _variance;  // in 1/FILTER_NOISE_ONE
+    uint32_t  _last;      // in ms
+};
+
+/**
+ * Until N readings came in, the median of the ones there are.
+ */
+template<uint8_t N>
+class MedianFilter {
+  public:
+    MedianFilter() { reset(); }
+    void reset() { _count = 0; _next = 0; }
+
+    int32_t apply(int32_t x, uint32_t, const FilterSettings&) {
+      _window[_next] = x;
+      _next = (_next + 1) % N;
+      if (_count < N)
+        _count++;
+
+      int32_t sorted[N];
+      for (uint8_t i = 0; i < _count; i++) {
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > _window[i]; j--)
+          sorted[j] = sorted[j - 1];
+        sorted[j] = _window[i];
+      }
+      return sorted[(_count - 1) / 2];
+    }
+
+  private:
+    int32_t   _window[N];
+    uint8_t   _count;
+    uint8_t   _next;
+};
+
+template<class... Stages>
+class FilterChain;
+
+template<>
+class FilterChain<> {
+  public:
+    void  reset() {}
+    int32_t apply(int32_t x, uint32_t, const FilterSettings&) { return x; }
+};
+
+/**
+ * Runs First, then the rest of the chain on its output.
+ */
+template<class First, class... Rest>
+class FilterChain<First, Rest...> {
+  public:
+    void reset() {
+      _first.reset();
+      _rest.reset();
+    }
+
+    /**
+     * @param x reading, from extendReading()
+     * @param now time of the reading, in ms
+     */
+    int32_t apply(int32_t x, uint32_t now, const FilterSettings& s) {
+      return _rest.apply(_first.apply(x, now, s), now, s);
+    }
+
+  private:
+    First                 _first;
+    FilterChain<Rest...>  _rest;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ SystemConfig.cpp - Parses the ESPID/set/config payload.
+*/
+
+#include "SystemConfig.h"
+
+#include <string.h>
+#include <CommandDispatcher.h>
+
+static bool keyIs(const uint8_t* key, uint16_t length, const char* name) {
+  return strlen(name) == length && memcmp(key, name, length) == 0;
+}
+
+bool parseGain(const uint8_t* value, uint16_t length, float& gain) {
+  float v;
+  if (!parseFloat(value, length, v) || v < 0 || v > CONFIG_MAX_GAIN)
+    return false;
+  gain = v;
+  return true;
+}
+
+static bool parseRange(const uint8_t* value, uint16_t length, float min, float max, float& v) {
+  float f;
+  if (!parseFloat(value, length, f) || f < min || f > max)
+    return false;
+  v = f;
+  return true;
+}
+
+bool parseVpd(const uint8_t* value, uint16_t length, uint16_t& vpd) {
+  float f;
+  if (!parseRange(value, length, 0, CONFIG_MAX_VPD, f))
+    return false;
+  vpd = (uint16_t)(f * 1000 + 0.5f);
+  return true;
+}
+
+bool parsePeriod(const uint8_t* value, uint16_t length, uint32_t& period) {
+  int32_t v;
+  if (!parseInt(value, length, v) || v < 0 || v > CONFIG_MAX_PERIOD)
+    return false;
+  period = v;
+  return true;
+}
+
+bool parseActiveTime(const uint8_t* value, uint16_t length, uint32_t& activeTime) {
+  int32_t v;
+  if (!parseInt(value, length, v) || v < 0 || v > CONFIG_MAX_PERIOD * 60)
+    return false;
+  activeTime = v;
+  return true;
+}
+
+bool validSchedule(uint32_t period, uint32_t activeTime) {
+  return period == 0 || activeTime <= period * 60;
+}
+
+// The filter coefficients are scaled integers in SystemData, see
+// FilterSettings.
+
+static bool parseSmoothing(const uint8_t* value, uint16_t length, uint16_t& smoothing) {
+  float f;
+  if (!parseRange(value, length, 0, 1, f) || FILTER_SMOOTHING(f) == 0)
+    return false;
+  smoothing = FILTER_SMOOTHING(f);
+  return true;
+}
+
+static bool parseRate(const uint8_t* value, uint16_t length, uint16_t& rate) {
+  float f;
+  if (!parseRange(value, length, 0, CONFIG_MAX_RATE, f))
+    return false;
+  rate = FILTER_RATE(f);
+  return true;
+}
+
+static bool parseNoise(const uint8_t* value, uint16_t length, uint32_t& noise) {
+  float f;
+  if (!parseRange(value, length, 0, CONFIG_MAX_NOISE, f))
+    return false;
+  noise = FILTER_NOISE(f);
+  return true;
+}
+
+static bool parseField(const uint8_t* key, uint16_t keyLength, const uint8_t* value,
+                       uint16_t valueLength, SystemData& data, uint8_t& fields) {
+  int32_t v;
+
+  if (keyIs(key, keyLength, "temperature")) {
+    if (!parseDeci(value, valueLength, v) || v < 0 || v > CONFIG_MAX_TEMPERATURE)
+      return false;
+    data.setTemperature = v;
+  } else if (keyIs(key, keyLength, "humidity")) {
+    if (!parseDeci(value, valueLength, v) || v < 0 || v > CONFIG_MAX_HUMIDITY)
+      return false;
+    data.setHumidity = v;
+  } else if (keyIs(key, keyLength, "vpd")) {
+    return parseVpd(value, valueLength, data.setVpd);
+  } else if (keyIs(key, keyLength, "period")) {
+    return parsePeriod(value, valueLength, data.humidifierPeriod);
+  } else if (keyIs(key, keyLength, "activetime")) {
+    return parseActiveTime(value, valueLength, data.humidifierActiveTime);
+  } else if (keyIs(key, keyLength, "kp")) {
+    return parseGain(value, valueLength, data.heaterKp);
+  } else if (keyIs(key, keyLength, "ki")) {
+    return parseGain(value, valueLength, data.heaterKi);
+  } else if (keyIs(key, keyLength, "kd")) {
+    return parseGain(value, valueLength, data.heaterKd);
+  } else if (keyIs(key, keyLength, "window")) {
+    if (!parseInt(value, valueLength, v) || v < CONFIG_MIN_WINDOW || v > CONFIG_MAX_WINDOW)
+      return false;
+    data.heaterWindow = v;
+  } else if (keyIs(key, keyLength, "tsmooth")) {
+    return parseSmoothing(value, valueLength, data.temperatureFilter.smoothing);
+  } else if (keyIs(key, keyLength, "hsmooth")) {
+    return parseSmoothing(value, valueLength, data.humidityFilter.smoothing);
+  } else if (keyIs(key, keyLength, "trate")) {
+    return parseRate(value, valueLength, data.temperatureFilter.maxRate);
+  } else if (keyIs(key, keyLength, "hrate")) {
+    return parseRate(value, valueLength, data.humidityFilter.maxRate);
+  } else if (keyIs(key, keyLength, "tnoise")) {
+    return parseNoise(value, valueLength, data.temperatureFilter.processNoise);
+  } else if (keyIs(key, keyLength, "hnoise")) {
+    return parseNoise(value, valueLength, data.humidityFilter.processNoise);
+  } else if (keyIs(key, keyLength, "state")) {
+    if (!parseInt(value, valueLength, v) || v < 0 || v > 1)
+      return false;
+    data.state = v;
+    fields |= CONFIG_HAS_STATE;
+  } else if (keyIs(key, keyLength, "start")) {
+    if (!parseInt(value, valueLength, v) || v < 0)
+      return false;
+    data.startEpochTime = v;
+    fields |= CONFIG_HAS_START;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parseSystemConfig(const uint8_t* payload, uint16_t length, SystemData& data, uint8_t& fields) {
+  fields = 0;
+  if (length == 0)
+    return false;
+
+  uint16_t i = 0;
+  while (i < length) {
+    uint16_t key = i;
+    while (i < length && payload[i] != '=' && payload[i] != ',')
+      i++;
+    if (i == length || payload[i] != '=')
+      return false;
+    uint16_t keyLength = i - key;
+
+    uint16_t value = ++i;
+    while (i < length && payload[i] != ',')
+      i++;
+    if (!parseField(payload + key, keyLength, payload + value, i - value, data, fields))
+      return false;
+    i++;    // ','
+  }
+
+  return validSchedule(data.humidifierPeriod, data.humidifierActiveTime);
+}
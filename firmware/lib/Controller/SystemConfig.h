@@ -0,0 +1,89 @@
+/*
+ SystemConfig.h - Parses the ESPID/set/config payload.
+
+ The payload is a list of key=value pairs separated by ',', for example
+
+   temperature=25.5,humidity=85,period=120,activetime=30
+
+ Keys are the SystemData fields: state (0 or 1), temperature (C),
+ humidity (%RH), vpd (vapour pressure deficit the humidifier holds instead
+ of humidity, in kPa, 0 to go back to humidity), start (epoch), period (humidifier period, in minutes),
+ activetime (humidifier active time, in seconds), kp, ki, kd (heater PID
+ gains) and window (heater window, in seconds). The sensor filters take
+ tsmooth, hsmooth (EMA weight, above 0 and up to 1), trate, hrate (largest
+ change per second, 0 for no limit) and tnoise, hnoise (Kalman process
+ noise per second), t for temperature and h for humidity. Keys that are
+ left out keep their current value.
+*/
+
+#ifndef SystemConfig_h
+#define SystemConfig_h
+
+#include <stdint.h>
+#include "SystemData.h"
+
+#define CONFIG_MAX_TEMPERATURE  600   // in 0.1 C
+#define CONFIG_MAX_HUMIDITY     1000  // in 0.1 %RH
+#define CONFIG_MAX_PERIOD       1440  // in minutes
+#define CONFIG_MAX_GAIN         1000
+#define CONFIG_MIN_WINDOW       10    // in seconds
+#define CONFIG_MAX_WINDOW       3600  // in seconds
+#define CONFIG_MAX_RATE         100   // in units per second
+#define CONFIG_MAX_NOISE        100
+#define CONFIG_MAX_VPD          5     // in kPa
+
+#define CONFIG_HAS_STATE  0x01
+#define CONFIG_HAS_START  0x02
+
+/**
+ * Applies payload to data, which should hold a copy of the current
+ * settings. data is only meaningful when the whole payload is valid, so the
+ * caller copies it back only on success.
+ *
+ * @return false on an unknown key, a malformed or out of range value, or an
+ * active time longer than the period. On success fields is set to the
+ * CONFIG_HAS_* bits of the keys that were present.
+ */
+bool parseSystemConfig(const uint8_t* payload, uint16_t length, SystemData& data, uint8_t& fields);
+
+/**
+ * Parses a heater PID gain, also used by the ESPID/set/heater/k* topics.
+ * gain is left untouched on error.
+ *
+ * @return false if payload is not a number between 0 and CONFIG_MAX_GAIN
+ */
+bool parseGain(const uint8_t* payload, uint16_t length, float& gain);
+
+/**
+ * Parses a VPD setpoint in kPa, also used by the ESPID/set/vpd topic, into
+ * Pa. vpd is left untouched on error.
+ *
+ * @return false if payload is not a number between 0 and CONFIG_MAX_VPD
+ */
+bool parseVpd(const uint8_t* payload, uint16_t length, uint16_t& vpd);
+
+/**
+ * Parses a humidifier period in minutes, also used by the
+ * ESPID/set/humidifier/period topic. period is left untouched on error.
+ *
+ * @return false if payload is not an integer between 0 and CONFIG_MAX_PERIOD
+ */
+bool parsePeriod(const uint8_t* payload, uint16_t length, uint32_t& period);
+
+/**
+ * Parses a humidifier active time in seconds, also used by the
+ * ESPID/set/humidifier/activetime topic. activeTime is left untouched on
+ * error.
+ *
+ * @return false if payload is not an integer between 0 and
+ * CONFIG_MAX_PERIOD * 60
+ */
+bool parseActiveTime(const uint8_t* payload, uint16_t length, uint32_t& activeTime);
+
+/**
+ * @return false if activeTime (in seconds) is longer than period (in
+ * minutes), 0 being no period
+ */
+bool validSchedule(uint32_t period, uint32_t activeTime);
+
+#endif
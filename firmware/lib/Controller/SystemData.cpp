@@ -0,0 +1,22 @@
+/*
+ SystemData.cpp - Settings persisted in SPIFFS and changed over MQTT.
+*/
+
+#include "SystemData.h"
+
+#include <string.h>
+#include "Controller.h"
+
+void defaultSystemData(SystemData& data) {
+  memset(&data, 0, sizeof(data));
+  data.heaterKp = DEFAULT_HEATER_KP;
+  data.heaterKi = DEFAULT_HEATER_KI;
+  data.heaterKd = DEFAULT_HEATER_KD;
+  data.heaterWindow = DEFAULT_HEATER_WINDOW;
+  data.temperatureFilter.smoothing = FILTER_SMOOTHING(TEMPERATURE_SMOOTHING_CONSTANT);
+  data.temperatureFilter.maxRate = FILTER_RATE(DEFAULT_TEMPERATURE_MAX_RATE);
+  data.temperatureFilter.processNoise = FILTER_NOISE(DEFAULT_SENSOR_PROCESS_NOISE);
+  data.humidityFilter.smoothing = FILTER_SMOOTHING(HUMIDITY_SMOOTHING_CONSTANT);
+  data.humidityFilter.maxRate = FILTER_RATE(DEFAULT_HUMIDITY_MAX_RATE);
+  data.humidityFilter.processNoise = FILTER_NOISE(DEFAULT_SENSOR_PROCESS_NOISE);
+}
@@ -0,0 +1,36 @@
+/*
+ SystemData.h - Settings persisted in SPIFFS and changed over MQTT.
+
+ With heaterKp and heaterKi both 0 the heater falls back to on/off control.
+ Setpoints are integers in the units of the readings they are compared
+ with; the settings record stores them as floats, see SettingsRecord.h.
+*/
+
+#ifndef SystemData_h
+#define SystemData_h
+
+#include <stdint.h>
+#include "SensorFilter.h"
+
+struct SystemData {
+    uint8_t   state;
+    int16_t   setTemperature;         // in 0.1 C
+    uint16_t  setHumidity;            // in 0.1 %RH
+    uint16_t  setVpd;                 // in Pa, above 0 it replaces setHumidity
+    uint32_t  startEpochTime;
+    uint32_t  humidifierPeriod;       // in minutes
+    uint32_t  humidifierActiveTime;   // in seconds
+    float     heaterKp;               // heater duty per Celsius of error
+    float     heaterKi;               // heater duty per Celsius second
+    float     heaterKd;               // heater duty per Celsius per second
+    uint32_t  heaterWindow;           // heater time-proportioning window, in seconds
+    FilterSettings  temperatureFilter;
+    FilterSettings  humidityFilter;
+};
+
+/**
+ * Fills data with the settings of a node that was never configured.
+ */
+void defaultSystemData(SystemData& data);
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ ThermalModel.cpp - Online identification of the chamber heat balance.
+*/
+
+#include "ThermalModel.h"
+
+#include <math.h>
+
+#define MODEL_INITIAL_COVARIANCE  1000.0f
+
+ThermalModel::ThermalModel() {
+  reset();
+}
+
+void ThermalModel::reset() {
+  for (uint8_t i = 0; i < MODEL_PARAMETERS; i++) {
+    theta[i] = 0;
+    for (uint8_t j = 0; j < MODEL_PARAMETERS; j++)
+      _p[i][j] = i == j ? MODEL_INITIAL_COVARIANCE : 0;
+  }
+  updates = 0;
+  noise = 0;
+  _weight = 0;
+  _spreadSum = 0;
+  _spreadSquares = 0;
+  restart();
+}
+
+void ThermalModel::restart() {
+  _started = false;
+  _heater = false;
+  _last = 0;
+  _sampleStart = 0;
+  _onTime = 0;
+  _sum = 0;
+  _count = 0;
+  _history = 0;
+  _t1 = 0;
+  _t2 = 0;
+  _u1 = 0;
+}
+
+void ThermalModel::update(uint32_t now, float temperature, bool heater) {
+  if (!_started) {
+    _started = true;
+    _sampleStart = now;
+  } else if (_heater) {
+    _onTime += now - _last;
+  }
+  _last = now;
+  _heater = heater;
+  _sum += temperature;
+  _count++;
+
+  uint32_t elapsed = now - _sampleStart;
+  if (elapsed < MODEL_INTERVAL)
+    return;
+
+  float t = _sum / _count;
+  float u = (float)_onTime / elapsed;
+  _sampleStart = now;
+  _onTime = 0;
+  _sum = 0;
+  _count = 0;
+
+  // The sample that just closed is T[k+1]; u is the duty that led to it.
+  if (_history == 2) {
+    float phi[MODEL_PARAMETERS] = { _t1 - MODEL_REFERENCE, _t1 - _t2, u, _u1, 1 };
+    observe(phi, t - _t1);
+  } else {
+    _history++;
+  }
+  _t2 = _t1;
+  _t1 = t;
+  _u1 = u;
+}
+
+// Standard RLS step.
+void ThermalModel::observe(const float* phi, float y) {
+  float pphi[MODEL_PARAMETERS];
+  float den = MODEL_FORGETTING;
+  float error = y;
+  for (uint8_t i = 0; i < MODEL_PARAMETERS; i++) {
+    pphi[i] = 0;
+    for (uint8_t j = 0; j < MODEL_PARAMETERS; j++)
+      pphi[i] += _p[i][j] * phi[j];
+    den += phi[i] * pphi[i];
+    error -= theta[i] * phi[i];
+  }
+
+  float trace = 0;
+  for (uint8_t i = 0; i < MODEL_PARAMETERS; i++) {
+    float k = pphi[i] / den;
+    theta[i] += k * error;
+    for (uint8_t j = 0; j < MODEL_PARAMETERS; j++)
+      _p[i][j] -= k * pphi[j];
+    trace += _p[i][i];
+  }
+
+  // Without excitation (steady duty and temperature) forgetting would let
+  // the covariance grow until one noisy sample throws the fit away.
+  if (trace < MODEL_MAX_TRACE)
+    for (uint8_t i = 0; i < MODEL_PARAMETERS; i++)
+      for (uint8_t j = 0; j < MODEL_PARAMETERS; j++)
+        _p[i][j] /= MODEL_FORGETTING;
+
+  // Residual variance, to turn the covariance into parameter errors.
+  float a = 1 - MODEL_FORGETTING;
+  if (a < 1.0f / (updates + 1))
+    a = 1.0f / (updates + 1);
+  noise += a * (error * error / den * MODEL_FORGETTING - noise);
+  updates++;
+
+  _weight = MODEL_FORGETTING * _weight + 1;
+  _spreadSum = MODEL_FORGETTING * _spreadSum + phi[0];
+  _spreadSquares = MODEL_FORGETTING * _spreadSquares + phi[0] * phi[0];
+}
+
+bool ThermalModel::valid() const {
+  return updates >= MODEL_MIN_UPDATES && theta[0] < 0 && theta[2] + theta[3] > 0;
+}
+
+bool ThermalModel::identified() const {
+  return valid() && spread() >= MODEL_MIN_SPREAD;
+}
+
+float ThermalModel::spread() const {
+  if (_weight == 0)
+    return 0;
+  float mean = _spreadSum / _weight;
+  float v = _spreadSquares / _weight - mean * mean;
+  return v > 0 ? sqrtf(v) : 0;
+}
+
+// The slowest root of z^2 - a1 z - a2 with a1 = 1 + alpha + beta and
+// a2 = -beta, converted to a continuous time constant.
+float ThermalModel::timeConstant() const {
+  float a1 = 1 + theta[0] + theta[1];
+  float a2 = -theta[1];
+  float disc = a1 * a1 + 4 * a2;
+  float z = disc >= 0 ? (a1 + sqrtf(disc)) / 2 : sqrtf(-a2);
+  if (z <= 0 || z >= 1)
+    return INFINITY;
+  return -(MODEL_INTERVAL / 1000.0f) / logf(z);
+}
+
+float ThermalModel::heaterGain() const {
+  return -(theta[2] + theta[3]) / theta[0];
+}
+
+float ThermalModel::ambient() const {
+  return MODEL_REFERENCE - theta[4] / theta[0];
+}
+
+// First order propagation of the covariance of alpha and b0 + b1.
+float ThermalModel::gainError() const {
+  float b = theta[2] + theta[3];
+  float vb = _p[2][2] + _p[3][3] + 2 * _p[2][3];
+  float vab = _p[0][2] + _p[0][3];
+  float r = vb / (b * b) + _p[0][0] / (theta[0] * theta[0]) - 2 * vab / (b * theta[0]);
+  if (r < 0)
+    r = 0;
+  return sqrtf(r * noise);
+}
+
+float ThermalModel::feedForward(float setpoint) const {
+  float u = -(theta[0] * (setpoint - MODEL_REFERENCE) + theta[4]) / (theta[2] + theta[3]);
+  if (u < 0)
+    return 0;
+  if (u > 1)
+    return 1;
+  return u;
+}
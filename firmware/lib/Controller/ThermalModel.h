@@ -0,0 +1,131 @@
+/*
+ ThermalModel.h - Online identification of the chamber heat balance.
+
+ The heater sits in a water reservoir, so the air follows it with a lag
+ and a first order model does not fit. Every MODEL_INTERVAL the average
+ temperature T and the fraction of time u the heater was on are taken as
+ one sample k of the second order model
+
+   T[k+1] - T[k] = alpha * (T[k] - R) + beta * (T[k] - T[k-1])
+                   + b0 * u[k] + b1 * u[k-1] + c
+
+ with R = MODEL_REFERENCE, fitted by recursive least squares with
+ exponential forgetting. From the fit:
+
+   heater gain    -(b0 + b1) / alpha, the rise over ambient at full power
+   ambient        R - c / alpha
+   time constant  of the slowest pole, in s
+
+ and the duty that holds a setpoint, used as feed-forward by the heater
+ PID. Memory is fixed: five parameters and a 5x5 covariance.
+
+ While the temperature is held at the setpoint the data carries little
+ information about the time constant, the heater gain and the ambient:
+ with T and u nearly constant only the balance alpha * (T - R) + (b0 + b1)
+ * u + c = 0 is seen, and the split between its terms is set by the
+ sensor noise and the feedback of the PID. The estimates then drift far
+ from the truth (in simulation a gain of 20 C came out as 5 C after two
+ weeks at one setpoint) while the covariance, and gainError(), stay small.
+ The steady state duty, which is what the feed-forward uses, is that
+ balance and stays well determined. The other parameters are only
+ reported as identified() once the sampled temperature spread over the
+ memory of the fit reaches MODEL_MIN_SPREAD, as after a setpoint change of
+ a few degrees.
+*/
+
+#ifndef ThermalModel_h
+#define ThermalModel_h
+
+#include <stdint.h>
+
+#ifndef MODEL_INTERVAL
+#define MODEL_INTERVAL      600000  // in ms
+#endif
+#ifndef MODEL_FORGETTING
+#define MODEL_FORGETTING    0.9995f // per sample, about two weeks of memory
+#endif
+#define MODEL_REFERENCE     25.0f   // in Celsius, keeps the regressors small
+#define MODEL_MIN_UPDATES   36      // samples before the fit is used
+#define MODEL_MAX_TRACE     1e6f    // covariance limit while there is no excitation
+#define MODEL_MIN_SPREAD    0.3f    // in Celsius, for identified()
+#define MODEL_PARAMETERS    5
+
+class ThermalModel {
+  public:
+    ThermalModel();
+
+    void reset();
+
+    /**
+     * Drops the sample in progress but keeps the fit, for when the control
+     * loop was paused.
+     */
+    void restart();
+
+    /**
+     * Called on every control step with the heater output that was just
+     * decided. Adds a sample once MODEL_INTERVAL has passed.
+     *
+     * @param now current time, in ms
+     */
+    void update(uint32_t now, float temperature, bool heater);
+
+    /**
+     * @return true once the fit has enough samples and makes physical sense
+     * (heat leaks out, the heater heats)
+     */
+    bool  valid() const;
+
+    /**
+     * @return true if valid() and the temperature moved enough within the
+     * memory of the fit for timeConstant(), heaterGain(), ambient() and
+     * gainError() to mean something
+     */
+    bool  identified() const;
+
+    /**
+     * @return the standard deviation of the sampled temperature, weighted
+     * with the forgetting of the fit, in Celsius
+     */
+    float spread() const;
+
+    float timeConstant() const;   // in s
+    float heaterGain() const;     // in Celsius over ambient at full power
+    float ambient() const;        // in Celsius
+
+    /**
+     * @return the steady state heater duty for setpoint, between 0 and 1
+     */
+    float feedForward(float setpoint) const;
+
+    /**
+     * @return the estimated standard deviation of heaterGain() relative to
+     * its value, from the covariance and the residual noise
+     */
+    float gainError() const;
+
+    float     theta[MODEL_PARAMETERS];  // alpha, beta, b0, b1, c
+    uint32_t  updates;
+    float     noise;                    // residual variance, in Celsius^2
+
+  private:
+    float     _p[MODEL_PARAMETERS][MODEL_PARAMETERS];
+    bool      _started;
+    bool      _heater;
+    uint32_t  _last;            // in ms
+    uint32_t  _sampleStart;     // in ms
+    uint32_t  _onTime;          // in the current interval, in ms
+    float     _sum;             // of the temperatures in the interval
+    uint16_t  _count;
+    uint8_t   _history;         // previous samples available, up to 2
+    float     _t1;              // T[k]
+    float     _t2;              // T[k-1]
+    float     _u1;              // u[k-1]
+    float     _weight;          // of the samples, with forgetting
+    float     _spreadSum;       // of T[k] - R, with forgetting
+    float     _spreadSquares;   // of (T[k] - R)^2, with forgetting
+
+    void observe(const float* phi, float y);
+};
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ Crc32.h - CRC-32 (IEEE 802.3, as in zlib) for records kept in flash and RTC
+ memory.
+
+ Uses a 16 entry table, two lookups per byte, which keeps the table in 64
+ bytes of flash.
+*/
+
+#ifndef Crc32_h
+#define Crc32_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Continues a CRC over length more bytes. Start with crc = 0; the result
+ * of one call can be passed to the next to cover discontiguous buffers.
+ */
+uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+#endif
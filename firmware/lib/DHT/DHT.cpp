@@ -6,19 +6,28 @@ written by Adafruit Industries
 
 #include "DHT.h"
 
+#include <string.h>
+
 #define MIN_INTERVAL 2000
 
+// States of a non-blocking read.
+#define DHT_IDLE      0
+#define DHT_START     1   // start signal low
+#define DHT_RECEIVE   2   // line released, edges are being recorded
+#define DHT_RETRY     3   // waiting DHT_RETRY_DELAY to send the start again
+
 DHT::DHT(uint8_t pin, uint8_t type, uint8_t count) {
   _pin = pin;
   _type = type;
-  #ifdef __AVR
-    _bit = digitalPinToBitMask(pin);
-    _port = digitalPinToPort(pin);
-  #endif
-  _maxcycles = microsecondsToClockCycles(1000);  // 1 millisecond timeout for
-                                                 // reading pulses from DHT sensor.
   // Note that count is now ignored as the DHT reading algorithm adjusts itself
   // basd on the speed of the processor.
+  _state = DHT_IDLE;
+  _retries = 0;
+  _startTime = 0;
+  _edgeCount = 0;
+  memset(&_sample, 0, sizeof(_sample));
+  _sample.status = DHT_ERROR_TIMEOUT;
+  memset(&_stats, 0, sizeof(_stats));
 }
 
 void DHT::begin(void) {
@@ -28,7 +37,6 @@ void DHT::begin(void) {
   // >= MIN_INTERVAL right away. Note that this assignment wraps around,
   // but so will the subtraction.
   _lastreadtime = -MIN_INTERVAL;
-  DEBUG_PRINT("Max clock cycles: "); DEBUG_PRINTLN(_maxcycles, DEC);
 }
 
 //boolean S == Scale.  True == Fahrenheit; False == Celcius
@@ -36,27 +44,30 @@ float DHT::readTemperature(bool S, bool force) {
   float f = NAN;
 
   if (read(force)) {
-    switch (_type) {
-    case DHT11:
-      f = data[2];
-      if(S) {
-        f = convertCtoF(f);
-      }
-      break;
-    case DHT22:
-    case DHT21:
-      f = data[2] & 0x7F;
-      f *= 256;
-      f += data[3];
-      f *= 0.1;
-      if (data[2] & 0x80) {
-        f *= -1;
-      }
-      if(S) {
-        f = convertCtoF(f);
-      }
-      break;
+    f = convertTemperature();
+    if(S) {
+      f = convertCtoF(f);
+    }
+  }
+  return f;
+}
+
+float DHT::convertTemperature(void) const {
+  float f = NAN;
+  switch (_type) {
+  case DHT11:
+    f = data[2];
+    break;
+  case DHT22:
+  case DHT21:
+    f = data[2] & 0x7F;
+    f *= 256;
+    f += data[3];
+    f *= 0.1;
+    if (data[2] & 0x80) {
+      f *= -1;
     }
+    break;
   }
   return f;
 }
@@ -71,19 +82,25 @@ float DHT::convertFtoC(float f) {
 
 float DHT::readHumidity(bool force) {
   float f = NAN;
-  if (read()) {
-    switch (_type) {
-    case DHT11:
-      f = data[0];
-      break;
-    case DHT22:
-    case DHT21:
-      f = data[0];
-      f *= 256;
-      f += data[1];
-      f *= 0.1;
-      break;
-    }
+  if (read(force)) {
+    f = convertHumidity();
+  }
+  return f;
+}
+
+float DHT::convertHumidity(void) const {
+  float f = NAN;
+  switch (_type) {
+  case DHT11:
+    f = data[0];
+    break;
+  case DHT22:
+  case DHT21:
+    f = data[0];
+    f *= 256;
+    f += data[1];
+    f *= 0.1;
+    break;
   }
   return f;
 }
@@ -120,6 +137,9 @@ float DHT::computeHeatIndex(float temperature, float percentHumidity, bool isFah
   return isFahrenheit ? hi : convertFtoC(hi);
 }
 
+// Kept only for a sensor on GPIO16, which has no pin interrupt for
+// start()/poll(): it waits about 270 ms in delay() and masks interrupts for
+// the 5 ms of the transfer.
 boolean DHT::read(bool force) {
   // Check if sensor was read less than two seconds ago and return early
   // to use last reading.
@@ -128,6 +148,7 @@ boolean DHT::read(bool force) {
     return _lastresult; // return last correct measurement
   }
   _lastreadtime = currenttime;
+  _retries = 0;
 
   // Reset 40 bits of received data to zero.
   data[0] = data[1] = data[2] = data[3] = data[4] = 0;
@@ -145,115 +166,192 @@ boolean DHT::read(bool force) {
   digitalWrite(_pin, LOW);
   delay(20);
 
-  uint32_t cycles[80];
+  // The line is sampled from the GPI register and every edge timed with the
+  // CPU cycle counter; bits are then told apart by their width in us, like
+  // in the non-blocking read. Interrupts are masked only until the last
+  // edge, not for a fixed worst case.
+  uint8_t edges;
+  _cyclesPerMicro = ESP.getCpuFreqMHz();
   {
-    // Turn off interrupts temporarily because the next sections are timing critical
-    // and we don't want any interruptions.
     InterruptLock lock;
+    pinMode(_pin, INPUT_PULLUP);
+    edges = captureEdges();
+  }
+  dhtCyclesToMicros(_edges, edges, _cyclesPerMicro);
+  return record(decodeDhtPulses(_edges, edges, data));
+}
+
+// Busy-waits for the edges of the answer with interrupts masked and stores
+// the low 16 bits of the cycle counter at each one. Stops after
+// DHT_MAX_EDGES edges or DHT_EDGE_TIMEOUT us without a change.
+// @return the number of edges
+uint8_t DHT::captureEdges(void) {
+  volatile uint32_t* input = _pin == 16 ? &GP16I : &GPI;
+  uint32_t mask = _pin == 16 ? 1 : 1 << _pin;
+  uint32_t timeout = DHT_EDGE_TIMEOUT * _cyclesPerMicro;
+  uint32_t level = *input & mask;
+  uint32_t last = ESP.getCycleCount();
+  uint8_t count = 0;
+
+  while (count < DHT_MAX_EDGES) {
+    uint32_t now = ESP.getCycleCount();
+    uint32_t l = *input & mask;
+    if (l != level) {
+      level = l;
+      last = now;
+      _edges[count++] = (uint16_t)now;
+    } else if (now - last > timeout) {
+      break;
+    }
+  }
+  return count;
+}
+
+// The start signal needs no exact length, so it is ended by the first poll()
+// after DHT_START_LOW_*; only the answer, about 5 ms of 26-80 us pulses, is
+// timing critical and that is left to the edge interrupt.
+bool DHT::start(void) {
+  if (_state != DHT_IDLE)
+    return false;
+
+  _retries = 0;
+  pinMode(_pin, OUTPUT);
+  digitalWrite(_pin, LOW);
+  _startTime = micros();
+  _state = DHT_START;
+  _cyclesPerMicro = ESP.getCpuFreqMHz();
+  return true;
+}
 
-    // End the start signal by setting data line high for 40 microseconds.
-    digitalWrite(_pin, HIGH);
-    delayMicroseconds(40);
+bool DHT::poll(void) {
+  uint32_t elapsed = micros() - _startTime;
 
-    // Now start reading the data line to get the value from the DHT sensor.
+  switch (_state) {
+  case DHT_START:
+    if (elapsed < (_type == DHT11 ? DHT_START_LOW_DHT11 : DHT_START_LOW_DHT22))
+      return false;
+    // The interrupt is attached first so the release itself is recorded.
+    _edgeCount = 0;
+    attachInterruptArg(digitalPinToInterrupt(_pin), edge, this, CHANGE);
     pinMode(_pin, INPUT_PULLUP);
-    delayMicroseconds(10);  // Delay a bit to let sensor pull data line low.
-
-    // First expect a low signal for ~80 microseconds followed by a high signal
-    // for ~80 microseconds again.
-    if (expectPulse(LOW) == 0) {
-      DEBUG_PRINTLN(F("Timeout waiting for start signal low pulse."));
-      _lastresult = false;
-      return _lastresult;
-    }
-    if (expectPulse(HIGH) == 0) {
-      DEBUG_PRINTLN(F("Timeout waiting for start signal high pulse."));
-      _lastresult = false;
-      return _lastresult;
-    }
+    _startTime = micros();
+    _state = DHT_RECEIVE;
+    return false;
+
+  case DHT_RECEIVE:
+    if (_edgeCount < DHT_MAX_EDGES && elapsed < DHT_RECEIVE_TIMEOUT)
+      return false;
+    return finish();
+
+  case DHT_RETRY:
+    if (millis() - _startTime < DHT_RETRY_DELAY)
+      return false;
+    pinMode(_pin, OUTPUT);
+    digitalWrite(_pin, LOW);
+    _startTime = micros();
+    _state = DHT_START;
+    return false;
+  }
+  return false;
+}
 
-    // Now read the 40 bits sent by the sensor.  Each bit is sent as a 50
-    // microsecond low pulse followed by a variable length high pulse.  If the
-    // high pulse is ~28 microseconds then it's a 0 and if it's ~70 microseconds
-    // then it's a 1.  We measure the cycle count of the initial 50us low pulse
-    // and use that to compare to the cycle count of the high pulse to determine
-    // if the bit is a 0 (high state cycle count < low state cycle count), or a
-    // 1 (high state cycle count > low state cycle count). Note that for speed all
-    // the pulses are read into a array and then examined in a later step.
-    for (int i=0; i<80; i+=2) {
-      cycles[i]   = expectPulse(LOW);
-      cycles[i+1] = expectPulse(HIGH);
-    }
-  } // Timing critical code is now complete.
-
-  // Inspect pulses and determine which ones are 0 (high state cycle count < low
-  // state cycle count), or 1 (high state cycle count > low state cycle count).
-  for (int i=0; i<40; ++i) {
-    uint32_t lowCycles  = cycles[2*i];
-    uint32_t highCycles = cycles[2*i+1];
-    if ((lowCycles == 0) || (highCycles == 0)) {
-      DEBUG_PRINTLN(F("Timeout waiting for pulse."));
-      _lastresult = false;
-      return _lastresult;
-    }
-    data[i/8] <<= 1;
-    // Now compare the low and high cycle times to see if the bit is a 0 or 1.
-    if (highCycles > lowCycles) {
-      // High cycles are greater than 50us low cycle count, must be a 1.
-      data[i/8] |= 1;
-    }
-    // Else high cycles are less than (or equal to, a weird case) the 50us low
-    // cycle count so this must be a zero.  Nothing needs to be changed in the
-    // stored data.
+void IRAM_ATTR DHT::edge(void* arg) {
+  DHT* dht = (DHT*)arg;
+  uint8_t n = dht->_edgeCount;
+  if (n < DHT_MAX_EDGES) {
+    dht->_edges[n] = (uint16_t)ESP.getCycleCount();
+    dht->_edgeCount = n + 1;
   }
+}
 
-  DEBUG_PRINTLN(F("Received:"));
-  DEBUG_PRINT(data[0], HEX); DEBUG_PRINT(F(", "));
-  DEBUG_PRINT(data[1], HEX); DEBUG_PRINT(F(", "));
-  DEBUG_PRINT(data[2], HEX); DEBUG_PRINT(F(", "));
-  DEBUG_PRINT(data[3], HEX); DEBUG_PRINT(F(", "));
-  DEBUG_PRINT(data[4], HEX); DEBUG_PRINT(F(" =? "));
-  DEBUG_PRINTLN((data[0] + data[1] + data[2] + data[3]) & 0xFF, HEX);
-
-  // Check we read 40 bits and that the checksum matches.
-  if (data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
-    _lastresult = true;
-    return _lastresult;
+// @return false if the read goes on with a retry
+bool DHT::finish(void) {
+  detachInterrupt(digitalPinToInterrupt(_pin));
+  dhtCyclesToMicros(_edges, _edgeCount, _cyclesPerMicro);
+  uint8_t status = decodeDhtPulses(_edges, _edgeCount, data);
+  DEBUG_PRINT(F("DHT edges: ")); DEBUG_PRINT(_edgeCount);
+  DEBUG_PRINT(F(", status: ")); DEBUG_PRINTLN(status);
+
+  if (status != DHT_OK && _retries < DHT_MAX_RETRIES) {
+    count(status);
+    _retries++;
+    _stats.retries++;
+    _startTime = millis();
+    _state = DHT_RETRY;
+    return false;
   }
-  else {
-    DEBUG_PRINTLN(F("Checksum failure!"));
-    _lastresult = false;
-    return _lastresult;
+
+  _state = DHT_IDLE;
+  // Keeps the blocking API from starting another transfer right away.
+  _lastreadtime = millis();
+  record(status);
+  return true;
+}
+
+void DHT::count(uint8_t status) {
+  _stats.reads++;
+  switch (status) {
+  case DHT_ERROR_TIMEOUT:
+    _stats.timeouts++;
+    break;
+  case DHT_ERROR_PULSE:
+    _stats.pulseErrors++;
+    break;
+  case DHT_ERROR_CHECKSUM:
+    _stats.checksumErrors++;
+    break;
   }
 }
 
-// Expect the signal line to be at the specified level for a period of time and
-// return a count of loop cycles spent at that level (this cycle count can be
-// used to compare the relative time of two pulses).  If more than a millisecond
-// ellapses without the level changing then the call fails with a 0 response.
-// This is adapted from Arduino's pulseInLong function (which is only available
-// in the very latest IDE versions):
-//   https://github.com/arduino/Arduino/blob/master/hardware/arduino/avr/cores/arduino/wiring_pulse.c
-uint32_t DHT::expectPulse(bool level) {
-  uint32_t count = 0;
-  // On AVR platforms use direct GPIO port access as it's much faster and better
-  // for catching pulses that are 10's of microseconds in length:
-  #ifdef __AVR
-    uint8_t portState = level ? _bit : 0;
-    while ((*portInputRegister(_port) & _bit) == portState) {
-      if (count++ >= _maxcycles) {
-        return 0; // Exceeded timeout, fail.
-      }
-    }
-  // Otherwise fall back to using digitalRead (this seems to be necessary on ESP8266
-  // right now, perhaps bugs in direct port access functions?).
-  #else
-    while (digitalRead(_pin) == level) {
-      if (count++ >= _maxcycles) {
-        return 0; // Exceeded timeout, fail.
-      }
-    }
-  #endif
+// Ends a read, blocking or not, with the transaction now in data[].
+bool DHT::record(uint8_t status) {
+  count(status);
+  _lastresult = status == DHT_OK;
+  _sample.rawTemperature = rawTemperature();
+  _sample.rawHumidity = rawHumidity();
+  // DHT11 frames are in whole units; no float on this path.
+  uint8_t scale = _type == DHT11 ? 10 : 1;
+  _sample.temperature = _lastresult ? _sample.rawTemperature * scale : 0;
+  _sample.humidity = _lastresult ? _sample.rawHumidity * scale : 0;
+  _sample.timestamp = millis();
+  _sample.status = status;
+  _sample.retries = _retries;
+  return _lastresult;
+}
 
-  return count;
+int16_t DHT::rawTemperature(void) const {
+  if (_type == DHT11)
+    return data[2];
+  int16_t t = ((data[2] & 0x7F) << 8) | data[3];
+  return data[2] & 0x80 ? -t : t;
+}
+
+uint16_t DHT::rawHumidity(void) const {
+  if (_type == DHT11)
+    return data[0];
+  return (data[0] << 8) | data[1];
+}
+
+bool DHT::busy(void) const {
+  return _state != DHT_IDLE;
+}
+
+uint8_t DHT::lastStatus(void) const {
+  return _sample.status;
+}
+
+float DHT::temperature(void) const {
+  return _sample.ok() ? _sample.temperature * 0.1f : NAN;
+}
+
+float DHT::humidity(void) const {
+  return _sample.ok() ? _sample.humidity * 0.1f : NAN;
+}
+
+DhtSample DHT::sample(void) const {
+  return _sample;
+}
+
+const DhtStats& DHT::stats(void) const {
+  return _stats;
 }
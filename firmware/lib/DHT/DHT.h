@@ -2,6 +2,10 @@
 
 MIT license
 written by Adafruit Industries
+
+This copy is for the ESP8266 only: edges are timed with its cycle counter
+and the non-blocking read needs attachInterruptArg() and IRAM_ATTR. The
+decoder, DhtDecoder.h, has no such dependency and also builds on the host.
 */
 #ifndef DHT_H
 #define DHT_H
@@ -11,6 +15,11 @@ written by Adafruit Industries
 #else
  #include "WProgram.h"
 #endif
+#include "DhtDecoder.h"
+
+#ifndef ESP8266
+#error "this DHT library only supports the ESP8266, see DhtDecoder.h for the portable part"
+#endif
 
 
 // Uncomment to enable printing out nice debug messages.
@@ -34,6 +43,44 @@ written by Adafruit Industries
 #define DHT21 21
 #define AM2301 21
 
+// Non-blocking reads (start()/poll()). The start signal is held low from
+// start() until the first poll() after this long; the DHT22 accepts up to
+// about 20 ms, the DHT11 needs at least 18 ms.
+#define DHT_START_LOW_DHT22   1100    // in us
+#define DHT_START_LOW_DHT11   20000   // in us
+#define DHT_RECEIVE_TIMEOUT   8000    // in us, a transfer takes about 5 ms
+#define DHT_EDGE_TIMEOUT      200     // in us, ends a blocking capture
+// A failed non-blocking read is sent again this many times, after
+// DHT_RETRY_DELAY: the sensor ignores a start signal too soon after the last.
+#define DHT_MAX_RETRIES       1
+#define DHT_RETRY_DELAY       2000    // in ms
+
+// The result of one bus transaction: every field comes from the same 40
+// bits, so temperature and humidity always belong together. The readings
+// are integers in 0.1 units for every sensor type; temperature() and
+// humidity() of the DHT give them in float.
+struct DhtSample {
+  int16_t   rawTemperature;   // as sent, 0.1 C (DHT22/21) or 1 C (DHT11) per unit
+  uint16_t  rawHumidity;      // as sent, 0.1 %RH (DHT22/21) or 1 %RH (DHT11) per unit
+  int16_t   temperature;      // in 0.1 C, 0 unless ok()
+  uint16_t  humidity;         // in 0.1 %RH, 0 unless ok()
+  uint32_t  timestamp;        // millis() at the end of the transaction
+  uint8_t   status;           // DHT_OK or DHT_ERROR_*
+  uint8_t   retries;          // failed transactions before this one
+
+  bool ok() const { return status == DHT_OK; }
+  uint32_t age(uint32_t now) const { return now - timestamp; }
+};
+
+// Counted since boot, retries included.
+struct DhtStats {
+  uint32_t  reads;
+  uint32_t  timeouts;
+  uint32_t  pulseErrors;
+  uint32_t  checksumErrors;
+  uint32_t  retries;
+};
+
 
 class DHT {
   public:
@@ -44,20 +91,53 @@ class DHT {
    float convertFtoC(float);
    float computeHeatIndex(float temperature, float percentHumidity, bool isFahrenheit=true);
    float readHumidity(bool force=false);
-   boolean read(bool force=false);
+   boolean read(bool force=false);   // blocking, only for a sensor on GPIO16
+
+   // Non-blocking read: start() sends the start signal and returns, the
+   // edges of the answer are timestamped by a pin change interrupt and
+   // poll(), called on every pass of loop(), decodes them once the transfer
+   // is over. Interrupts are never masked and nothing waits. GPIO16 has no
+   // pin interrupt on the ESP8266, so there this path only times out; a
+   // sensor on GPIO16 needs the blocking read(), whose captureEdges()
+   // samples it from its own register.
+   bool start(void);
+   bool poll(void);          // true once, when the read started last finished
+   bool busy(void) const;
+   uint8_t lastStatus(void) const;   // DHT_OK or DHT_ERROR_* of the last read
+   float temperature(void) const;    // of the last read, NAN if it failed
+   float humidity(void) const;       // of the last read, NAN if it failed
+
+   /**
+    * @return the last completed read, blocking or not, with its time and
+    * status; a read that failed keeps the raw fields of the failed transfer
+    */
+   DhtSample sample(void) const;
+   const DhtStats& stats(void) const;
 
  private:
   uint8_t data[5];
   uint8_t _pin, _type;
-  #ifdef __AVR
-    // Use direct GPIO access on an 8-bit AVR so keep track of the port and bitmask
-    // for the digital pin connected to the DHT.  Other platforms will use digitalRead.
-    uint8_t _bit, _port;
-  #endif
-  uint32_t _lastreadtime, _maxcycles;
+  uint32_t _lastreadtime;
   bool _lastresult;
 
-  uint32_t expectPulse(bool level);
+  uint8_t captureEdges(void);
+  uint8_t _cyclesPerMicro;        // CPU clock in MHz during the capture
+  float convertTemperature(void) const;
+  float convertHumidity(void) const;
+  int16_t rawTemperature(void) const;
+  uint16_t rawHumidity(void) const;
+  void count(uint8_t status);
+  bool record(uint8_t status);
+
+  static void edge(void* arg);
+  bool finish(void);
+
+  uint8_t _state, _retries;
+  uint32_t _startTime;            // in us, or in ms while waiting to retry
+  DhtSample _sample;
+  DhtStats _stats;
+  volatile uint8_t _edgeCount;
+  uint16_t _edges[DHT_MAX_EDGES]; // low 16 bits of the cycle counter
 
 };
 
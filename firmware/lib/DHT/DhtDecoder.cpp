@@ -0,0 +1,71 @@
+/*
+ DhtDecoder.cpp - Turns the edges of a DHT transfer into its 5 data bytes.
+*/
+
+#include "DhtDecoder.h"
+
+#define DHT_BIT_EDGES   80
+
+static bool within(uint16_t width, uint16_t min, uint16_t max) {
+  return width >= min && width <= max;
+}
+
+static uint8_t decodeFrom(const uint16_t* edges, uint8_t first, uint8_t data[5]) {
+  data[0] = data[1] = data[2] = data[3] = data[4] = 0;
+
+  // edges[first] starts the low pulse of bit 0.
+  for (uint8_t i = 0; i < 40; i++) {
+    const uint16_t* e = edges + first + 2 * i;
+    uint16_t low = e[1] - e[0];
+    uint16_t high = e[2] - e[1];
+    if (!within(low, DHT_BIT_LOW_MIN, DHT_BIT_LOW_MAX))
+      return DHT_ERROR_PULSE;
+
+    data[i / 8] <<= 1;
+    if (within(high, DHT_ONE_MIN, DHT_ONE_MAX))
+      data[i / 8] |= 1;
+    else if (!within(high, DHT_ZERO_MIN, DHT_ZERO_MAX))
+      return DHT_ERROR_PULSE;
+  }
+
+  if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
+    return DHT_ERROR_CHECKSUM;
+  return DHT_OK;
+}
+
+// The release of the line may or may not show up as an edge and the delay
+// before the sensor answers varies, so every pair of pulses that looks like
+// the 80 us answer is tried as the start of the data.
+uint8_t decodeDhtPulses(const uint16_t* edges, uint8_t count, uint8_t data[5]) {
+  uint8_t result = DHT_ERROR_TIMEOUT;
+  for (uint8_t i = 0; i + 2 + DHT_BIT_EDGES < count; i++) {
+    uint16_t low = edges[i + 1] - edges[i];
+    uint16_t high = edges[i + 2] - edges[i + 1];
+    if (!within(low, DHT_RESPONSE_MIN, DHT_RESPONSE_MAX)
+        || !within(high, DHT_RESPONSE_MIN, DHT_RESPONSE_MAX))
+      continue;
+
+    uint8_t r = decodeFrom(edges, i + 2, data);
+    if (r == DHT_OK)
+      return DHT_OK;
+    if (result == DHT_ERROR_TIMEOUT || r == DHT_ERROR_CHECKSUM)
+      result = r;
+  }
+  return result;
+}
+
+// Differences are taken modulo 2^16 and summed in 32 bits, so the result
+// does not drift by the rounding of each pulse.
+void dhtCyclesToMicros(uint16_t* edges, uint8_t count, uint8_t cyclesPerMicro) {
+  if (count == 0)
+    return;
+
+  uint32_t elapsed = 0;
+  uint16_t last = edges[0];
+  edges[0] = 0;
+  for (uint8_t i = 1; i < count; i++) {
+    elapsed += (uint16_t)(edges[i] - last);
+    last = edges[i];
+    edges[i] = elapsed / cyclesPerMicro;
+  }
+}
@@ -0,0 +1,54 @@
+/*
+ DhtDecoder.h - Turns the edges of a DHT transfer into its 5 data bytes.
+
+ The driver only records when the data line changed, in microseconds; this
+ file does the rest and has no Arduino dependencies, so it can be run on
+ the host against captured pulse trains.
+
+ After the host releases the line the sensor answers with an 80 us low and
+ an 80 us high pulse, then sends 40 bits, each a 50 us low pulse followed
+ by a high pulse of 26-28 us for a 0 or 70 us for a 1. Bits are told apart
+ by the measured width of the high pulse, and every pulse must fall within
+ the DHT_* tolerances below, so a corrupted edge is reported instead of
+ silently flipping a bit.
+*/
+
+#ifndef DhtDecoder_h
+#define DhtDecoder_h
+
+#include <stdint.h>
+
+#define DHT_MAX_EDGES       96    // release, response, 80 bit edges and some slack
+
+// Pulse widths accepted, in us, with room for interrupt latency.
+#define DHT_RESPONSE_MIN    40
+#define DHT_RESPONSE_MAX    120
+#define DHT_BIT_LOW_MIN     30
+#define DHT_BIT_LOW_MAX     90
+#define DHT_ZERO_MIN        10
+#define DHT_ZERO_MAX        45
+#define DHT_ONE_MIN         55
+#define DHT_ONE_MAX         100
+
+#define DHT_OK              0
+#define DHT_ERROR_TIMEOUT   1     // no answer, or the transfer stopped early
+#define DHT_ERROR_PULSE     2     // a pulse out of tolerance
+#define DHT_ERROR_CHECKSUM  3
+
+/**
+ * Decodes a transfer from the times of its edges. edges holds the low 16
+ * bits of micros() at every change of the line, in order, from the release
+ * of the start signal on; the level of each edge is not needed.
+ *
+ * @return DHT_OK with the bytes in data, or one of DHT_ERROR_*
+ */
+uint8_t decodeDhtPulses(const uint16_t* edges, uint8_t count, uint8_t data[5]);
+
+/**
+ * Converts edges timed with the low 16 bits of a CPU cycle counter to us
+ * since the first edge, in place. Gaps between edges must stay under 65536
+ * cycles (409 us at 160 MHz), far more than any DHT pulse.
+ */
+void dhtCyclesToMicros(uint16_t* edges, uint8_t count, uint8_t cyclesPerMicro);
+
+#endif
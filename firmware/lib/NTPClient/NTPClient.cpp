@@ -107,6 +107,11 @@ unsigned long NTPClient::getEpochTime() {
          ((millis() - this->_lastUpdate) / 1000); // Time since last update
 }
 
+void NTPClient::setEpochTime(unsigned long secs) {
+  this->_currentEpoc = secs - this->_timeOffset;
+  this->_lastUpdate = millis();
+}
+
 int NTPClient::getDay() {
   return (((this->getEpochTime()  / 86400L) + 4 ) % 7); //0 is Sunday
 }
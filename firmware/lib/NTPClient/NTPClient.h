@@ -84,6 +84,12 @@ class NTPClient {
      */
     unsigned long getEpochTime();
 
+    /**
+     * Sets the time until the next update, e.g. from a copy kept across a
+     * reset. The next update happens after the update interval.
+     */
+    void setEpochTime(unsigned long secs);
+
     /**
      * Stops the underlying UDP client
      */
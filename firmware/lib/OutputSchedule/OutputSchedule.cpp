@@ -0,0 +1,189 @@
+/*
+ OutputSchedule.cpp - On/off time windows for an output.
+*/
+
+#include "OutputSchedule.h"
+
+#include <string.h>
+#include <CommandDispatcher.h>
+
+#define SCHEDULE_NEVER  0xFFFFFFFFUL
+#define SCHEDULE_DAY    86400UL
+
+OutputSchedule::OutputSchedule() {
+  clear();
+  _maxDuty = 0;
+  _dutyHour = 0;
+  _dutyUsed = 0;
+  _lastLimit = 0;
+  _lastOn = false;
+}
+
+void OutputSchedule::clear() {
+  memset(_windows, 0, sizeof(_windows));
+  _count = 0;
+  _valid = false;
+}
+
+bool OutputSchedule::add(uint32_t period, uint32_t start, uint32_t length) {
+  if (_count == SCHEDULE_MAX_WINDOWS || length == 0 || length > period || start >= period)
+    return false;
+  _windows[_count].period = period;
+  _windows[_count].start = start;
+  _windows[_count].length = length;
+  _count++;
+  _valid = false;
+  return true;
+}
+
+uint8_t OutputSchedule::count() const {
+  return _count;
+}
+
+const ScheduleWindow& OutputSchedule::window(uint8_t index) const {
+  return _windows[index];
+}
+
+bool OutputSchedule::active(uint32_t epoch) {
+  if (_valid && epoch >= _from && epoch < _next)
+    return _state;
+
+  _state = false;
+  _next = SCHEDULE_NEVER;
+  for (uint8_t i = 0; i < _count; i++) {
+    const ScheduleWindow& w = _windows[i];
+    uint32_t phase = (epoch + w.period - w.start) % w.period;
+    uint32_t change;
+    if (phase < w.length) {
+      _state = true;
+      change = w.length - phase;
+    } else {
+      change = w.period - phase;
+    }
+    if (w.length == w.period)
+      change = SCHEDULE_NEVER - epoch;    // always on
+    if (epoch + change < _next && epoch + change > epoch)
+      _next = epoch + change;
+  }
+  _from = epoch;
+  _valid = true;
+  return _state;
+}
+
+uint32_t OutputSchedule::nextTransition() const {
+  return _valid ? _next : SCHEDULE_NEVER;
+}
+
+void OutputSchedule::setMaxDuty(uint8_t percent) {
+  _maxDuty = percent >= 100 ? 0 : percent;
+}
+
+uint8_t OutputSchedule::maxDuty() const {
+  return _maxDuty;
+}
+
+bool OutputSchedule::limit(bool on, uint32_t epoch) {
+  uint32_t hour = epoch / SCHEDULE_DUTY_WINDOW;
+  if (hour != _dutyHour) {
+    _dutyHour = hour;
+    _dutyUsed = 0;
+  } else if (_lastOn && epoch > _lastLimit) {
+    _dutyUsed += epoch - _lastLimit;
+  }
+  _lastLimit = epoch;
+
+  if (_maxDuty != 0 && _dutyUsed >= _maxDuty * (SCHEDULE_DUTY_WINDOW / 100))
+    on = false;
+  _lastOn = on;
+  return on;
+}
+
+static bool parseClock(const uint8_t* p, uint16_t length, uint32_t& seconds) {
+  if (length < 4 || length > 5 || p[length - 3] != ':')
+    return false;
+  int32_t hours, minutes;
+  if (!parseInt(p, length - 3, hours) || !parseInt(p + length - 2, 2, minutes))
+    return false;
+  if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59)
+    return false;
+  seconds = hours * 3600UL + minutes * 60UL;
+  return true;
+}
+
+static bool parseWindow(const uint8_t* p, uint16_t length, OutputSchedule& schedule) {
+  uint16_t i = 0;
+  while (i < length && p[i] != '-' && p[i] != '/')
+    i++;
+  if (i == length)
+    return false;
+
+  if (p[i] == '-') {
+    uint32_t from, to;
+    if (!parseClock(p, i, from) || !parseClock(p + i + 1, length - i - 1, to) || from == to)
+      return false;
+    return schedule.add(SCHEDULE_DAY, from, (to + SCHEDULE_DAY - from) % SCHEDULE_DAY);
+  }
+
+  int32_t minutes, seconds;
+  if (!parseInt(p, i, minutes) || !parseInt(p + i + 1, length - i - 1, seconds))
+    return false;
+  if (minutes <= 0 || minutes > 1440 || seconds <= 0)
+    return false;
+  return schedule.add(minutes * 60UL, 0, seconds);
+}
+
+bool parseSchedule(const uint8_t* payload, uint16_t length, OutputSchedule& schedule) {
+  OutputSchedule next = schedule;
+  next.clear();
+
+  uint16_t i = 0;
+  while (i < length) {
+    uint16_t start = i;
+    while (i < length && payload[i] != ';')
+      i++;
+    if (!parseWindow(payload + start, i - start, next))
+      return false;
+    i++;    // ';'
+  }
+
+  schedule = next;
+  return true;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void encodeSchedule(const OutputSchedule& schedule, uint8_t* buf) {
+  memset(buf, 0, SCHEDULE_RECORD_SIZE);
+  buf[0] = schedule.count();
+  buf[1] = schedule.maxDuty();
+  for (uint8_t i = 0; i < schedule.count(); i++) {
+    const ScheduleWindow& w = schedule.window(i);
+    put32(buf + 2 + i * 12, w.period);
+    put32(buf + 6 + i * 12, w.start);
+    put32(buf + 10 + i * 12, w.length);
+  }
+}
+
+bool decodeSchedule(const uint8_t* buf, OutputSchedule& schedule) {
+  if (buf[0] > SCHEDULE_MAX_WINDOWS || buf[1] >= 100)
+    return false;
+
+  OutputSchedule next = schedule;
+  next.clear();
+  for (uint8_t i = 0; i < buf[0]; i++)
+    if (!next.add(get32(buf + 2 + i * 12), get32(buf + 6 + i * 12), get32(buf + 10 + i * 12)))
+      return false;
+  next.setMaxDuty(buf[1]);
+
+  schedule = next;
+  return true;
+}
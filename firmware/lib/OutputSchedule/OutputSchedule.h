@@ -0,0 +1,116 @@
+/*
+ OutputSchedule.h - On/off time windows for an output.
+
+ A schedule is a list of up to SCHEDULE_MAX_WINDOWS windows. A window
+ repeats every period and is on for length seconds starting start seconds
+ into the period, where periods are counted from midnight of Jan. 1, 1970
+ in local time: with a period of one day a window is a time of day rule,
+ with a period of an hour or less it is a pulse aligned to the clock. The
+ output is on while any window is on.
+
+ active() works out the state and the next time any window changes and
+ then only compares the time against it until that moment comes, so it
+ can be called on every control step. Changing the windows or the clock
+ going backwards makes it start over.
+
+ A schedule can also cap the duty of the output it drives, see limit().
+
+ ESPID/set/<output>/schedule payloads are windows separated by ';', each
+ either a time of day range "HH:MM-HH:MM" (it may wrap past midnight) or
+ a pulse "P/S", on for S seconds every P minutes. An empty payload clears
+ the schedule. For example "06:00-06:30;18:00-18:30;60/20".
+*/
+
+#ifndef OutputSchedule_h
+#define OutputSchedule_h
+
+#include <stdint.h>
+
+#define SCHEDULE_MAX_WINDOWS  4
+#define SCHEDULE_DUTY_WINDOW  3600    // in s, the duty limit applies per clock hour
+#define SCHEDULE_RECORD_SIZE  (2 + SCHEDULE_MAX_WINDOWS * 12)
+
+struct ScheduleWindow {
+  uint32_t  period;   // in s
+  uint32_t  start;    // in s from the start of the period
+  uint32_t  length;   // in s
+};
+
+class OutputSchedule {
+  public:
+    OutputSchedule();
+
+    void clear();
+
+    /**
+     * @return false if the schedule is full or the window is empty or
+     * longer than its period
+     */
+    bool add(uint32_t period, uint32_t start, uint32_t length);
+
+    uint8_t count() const;
+    const ScheduleWindow& window(uint8_t index) const;
+
+    /**
+     * @param epoch local time, in s since Jan. 1, 1970
+     * @return true while any window is on
+     */
+    bool active(uint32_t epoch);
+
+    /**
+     * @return the time active() changes next, valid after a call to
+     * active(); 0xFFFFFFFF if it never does
+     */
+    uint32_t nextTransition() const;
+
+    /**
+     * Caps the time the output is on to percent of every clock hour, 0 or
+     * 100 for no limit.
+     */
+    void    setMaxDuty(uint8_t percent);
+    uint8_t maxDuty() const;
+
+    /**
+     * Applies the duty limit to the state the output is about to take. Call
+     * it on every control step with the final decision for the output.
+     *
+     * @return on, or false once the output used up its share of the hour
+     */
+    bool limit(bool on, uint32_t epoch);
+
+  private:
+    ScheduleWindow  _windows[SCHEDULE_MAX_WINDOWS];
+    uint8_t         _count;
+    bool            _valid;       // _state and _next are up to date
+    bool            _state;
+    uint32_t        _from;        // time _state was worked out
+    uint32_t        _next;        // time of the next change
+    uint8_t         _maxDuty;     // in percent
+    uint32_t        _dutyHour;    // epoch / SCHEDULE_DUTY_WINDOW being counted
+    uint32_t        _dutyUsed;    // in s, during _dutyHour
+    uint32_t        _lastLimit;   // time of the previous limit() call
+    bool            _lastOn;      // what limit() returned last
+};
+
+/**
+ * Parses an ESPID/set/<output>/schedule payload into schedule, which is
+ * only changed on success. The duty limit is kept.
+ *
+ * @return false on a malformed window or more than SCHEDULE_MAX_WINDOWS
+ */
+bool parseSchedule(const uint8_t* payload, uint16_t length, OutputSchedule& schedule);
+
+/**
+ * Writes the windows and duty limit of schedule into SCHEDULE_RECORD_SIZE
+ * bytes: count, max duty, then period, start and length of every window,
+ * 4 bytes each little-endian, unused windows as 0.
+ */
+void encodeSchedule(const OutputSchedule& schedule, uint8_t* buf);
+
+/**
+ * @return false if the record makes no sense, schedule is then left
+ * untouched
+ */
+bool decodeSchedule(const uint8_t* buf, OutputSchedule& schedule);
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ ScheduleStore.cpp - Keeps the output schedules in SPIFFS.
+*/
+
+#include "ScheduleStore.h"
+
+#include <string.h>
+#include <FS.h>
+#include <Crc32.h>
+
+#define SCHEDULE_MAGIC    0x44484353UL  // "SCHD"
+#define SCHEDULE_FILE_SIZE(count) (5 + (count) * SCHEDULE_RECORD_SIZE + 4)
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool readSchedules(const char* path, OutputSchedule* const* schedules, uint8_t count) {
+  File f = SPIFFS.open(path, "r");
+  if (!f)
+    return false;
+
+  uint8_t buf[SCHEDULE_FILE_SIZE(SCHEDULE_MAX_STORED) + 1];
+  uint16_t length = f.read(buf, sizeof(buf));
+  f.close();
+
+  if (length != SCHEDULE_FILE_SIZE(count) || get32(buf) != SCHEDULE_MAGIC || buf[4] != count)
+    return false;
+  if (get32(buf + length - 4) != crc32(buf, length - 4))
+    return false;
+
+  // Decoded into copies first so a bad record changes nothing.
+  OutputSchedule loaded[SCHEDULE_MAX_STORED];
+  for (uint8_t i = 0; i < count; i++) {
+    loaded[i] = *schedules[i];
+    if (!decodeSchedule(buf + 5 + i * SCHEDULE_RECORD_SIZE, loaded[i]))
+      return false;
+  }
+  for (uint8_t i = 0; i < count; i++)
+    *schedules[i] = loaded[i];
+  return true;
+}
+
+// A reset between the remove and the rename leaves only the temporary file.
+bool loadSchedules(OutputSchedule* const* schedules, uint8_t count) {
+  if (count > SCHEDULE_MAX_STORED)
+    return false;
+  return readSchedules(SCHEDULE_FILE, schedules, count)
+         || readSchedules(SCHEDULE_TEMP_FILE, schedules, count);
+}
+
+bool saveSchedules(OutputSchedule* const* schedules, uint8_t count) {
+  if (count > SCHEDULE_MAX_STORED)
+    return false;
+
+  uint8_t buf[SCHEDULE_FILE_SIZE(SCHEDULE_MAX_STORED)];
+  put32(buf, SCHEDULE_MAGIC);
+  buf[4] = count;
+  for (uint8_t i = 0; i < count; i++)
+    encodeSchedule(*schedules[i], buf + 5 + i * SCHEDULE_RECORD_SIZE);
+  uint16_t length = SCHEDULE_FILE_SIZE(count);
+  put32(buf + length - 4, crc32(buf, length - 4));
+
+  File f = SPIFFS.open(SCHEDULE_FILE, "r");
+  if (f) {
+    uint8_t stored[SCHEDULE_FILE_SIZE(SCHEDULE_MAX_STORED)];
+    bool same = f.read(stored, sizeof(stored)) == length && memcmp(stored, buf, length) == 0;
+    f.close();
+    if (same)
+      return true;
+  }
+
+  f = SPIFFS.open(SCHEDULE_TEMP_FILE, "w");
+  if (!f)
+    return false;
+  bool ok = f.write(buf, length) == length;
+  f.close();
+  if (!ok)
+    return false;
+
+  SPIFFS.remove(SCHEDULE_FILE);
+  return SPIFFS.rename(SCHEDULE_TEMP_FILE, SCHEDULE_FILE);
+}
@@ -0,0 +1,34 @@
+/*
+ ScheduleStore.h - Keeps the output schedules in SPIFFS.
+
+ All schedules go in one file: magic "SCHD", a count, the records of
+ encodeSchedule() and a CRC-32 of everything before it. Like the recipe,
+ it is written to a temporary file that then replaces SCHEDULE_FILE.
+ SPIFFS must already be mounted (see SettingsStore).
+*/
+
+#ifndef ScheduleStore_h
+#define ScheduleStore_h
+
+#include "OutputSchedule.h"
+
+#define SCHEDULE_FILE       "/schedule"
+#define SCHEDULE_TEMP_FILE  "/schedule.tmp"
+#define SCHEDULE_MAX_STORED 4
+
+/**
+ * Loads count schedules in the order they were saved.
+ *
+ * @return false if there is no valid file for count schedules; the
+ * schedules are then left untouched
+ */
+bool loadSchedules(OutputSchedule* const* schedules, uint8_t count);
+
+/**
+ * Writes the schedules unless the file already holds the same ones.
+ *
+ * @return false if the file could not be written
+ */
+bool saveSchedules(OutputSchedule* const* schedules, uint8_t count);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ Psychrometrics.cpp - Dew point, VPD and absolute humidity without floating point.
+*/
+
+#include "Psychrometrics.h"
+
+#define TABLE_SIZE  121
+
+// Saturation vapour pressure in Pa, one entry per C from -40 C.
+static const uint16_t saturation[TABLE_SIZE] = {
+     19,    21,    23,    26,    29,    32,    35,    38,    42,    47, // -40 C
+     51,    56,    62,    68,    74,    81,    89,    97,   106,   116, // -30 C
+    126,   137,   149,   163,   177,   192,   208,   226,   245,   265, // -20 C
+    287,   310,   336,   363,   391,   422,   455,   490,   528,   568, // -10 C
+    611,   657,   706,   758,   813,   872,   934,  1001,  1071,  1146, // 0 C
+   1226,  1310,  1400,  1495,  1595,  1702,  1814,  1933,  2059,  2192, // 10 C
+   2333,  2481,  2637,  2803,  2977,  3160,  3353,  3557,  3771,  3997, // 20 C
+   4234,  4483,  4745,  5020,  5309,  5613,  5931,  6265,  6616,  6983, // 30 C
+   7367,  7770,  8192,  8634,  9096,  9580, 10085, 10614, 11166, 11743, // 40 C
+  12345, 12974, 13630, 14315, 15029, 15774, 16550, 17359, 18202, 19080, // 50 C
+  19993, 20944, 21934, 22963, 24034, 25147, 26304, 27506, 28754, 30051, // 60 C
+  31398, 32795, 34246, 35751, 37311, 38930, 40608, 42347, 44149, 46015, // 70 C
+  47949                                                                 // 80 C
+};
+
+uint16_t saturationPressure(int16_t temperature) {
+  if (temperature <= PSYCHRO_MIN_TEMPERATURE)
+    return saturation[0];
+  if (temperature >= PSYCHRO_MAX_TEMPERATURE)
+    return saturation[TABLE_SIZE - 1];
+
+  uint16_t t = temperature - PSYCHRO_MIN_TEMPERATURE;
+  uint8_t i = t / 10;
+  uint8_t f = t % 10;
+  return saturation[i] + ((uint32_t)(saturation[i + 1] - saturation[i]) * f + 5) / 10;
+}
+
+uint16_t vapourPressure(int16_t temperature, uint16_t humidity) {
+  if (humidity > 1000)
+    humidity = 1000;
+  return ((uint32_t)saturationPressure(temperature) * humidity + 500) / 1000;
+}
+
+uint16_t vapourPressureDeficit(int16_t temperature, uint16_t humidity) {
+  return saturationPressure(temperature) - vapourPressure(temperature, humidity);
+}
+
+// Inverse of saturationPressure(): the table is increasing, so a binary
+// search finds the interval and the fraction is interpolated.
+int16_t dewPoint(int16_t temperature, uint16_t humidity) {
+  uint16_t e = vapourPressure(temperature, humidity);
+  if (e <= saturation[0])
+    return PSYCHRO_MIN_TEMPERATURE;
+  if (e >= saturation[TABLE_SIZE - 1])
+    return PSYCHRO_MAX_TEMPERATURE;
+
+  uint8_t lo = 0, hi = TABLE_SIZE - 1;
+  while (hi - lo > 1) {
+    uint8_t mid = (lo + hi) / 2;
+    if (saturation[mid] <= e)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  uint16_t span = saturation[hi] - saturation[lo];
+  uint16_t f = ((uint32_t)(e - saturation[lo]) * 10 + span / 2) / span;
+  return PSYCHRO_MIN_TEMPERATURE + lo * 10 + f;
+}
+
+// e / (Rv T) with Rv = 461.5 J/(kg K): 216.68 e / T in 0.1 g/m^3 for T in
+// 0.1 K.
+uint16_t absoluteHumidity(int16_t temperature, uint16_t humidity) {
+  uint32_t kelvin = temperature + 2732;
+  return ((uint32_t)vapourPressure(temperature, humidity) * 21668 / 100 + kelvin / 2) / kelvin;
+}
+
+uint16_t humidityForDeficit(int16_t temperature, uint16_t vpd) {
+  uint16_t es = saturationPressure(temperature);
+  if (vpd >= es)
+    return 0;
+  return ((uint32_t)(es - vpd) * 1000 + es / 2) / es;
+}
@@ -0,0 +1,57 @@
+/*
+ Psychrometrics.h - Dew point, vapour pressure deficit and absolute
+ humidity without floating point.
+
+ Inputs are in the units the DHT22 sends, temperature in 0.1 C and
+ relative humidity in 0.1 %RH, so raw readings go in as they are. The
+ saturation vapour pressure over water (Magnus, 6.112 hPa * exp(17.62 T /
+ (243.12 + T)), the formula of the chamber simulator) comes from a table
+ in 1 C steps from -40 to 80 C, interpolated linearly; the error of the
+ interpolation stays under 0.1 %. Everything else is integer arithmetic,
+ a few multiplications and one division per value, instead of the
+ double precision exp() and log() the ESP8266 would run in software.
+*/
+
+#ifndef Psychrometrics_h
+#define Psychrometrics_h
+
+#include <stdint.h>
+
+#define PSYCHRO_MIN_TEMPERATURE   -400  // in 0.1 C, the table range
+#define PSYCHRO_MAX_TEMPERATURE   800   // in 0.1 C
+
+/**
+ * @return the saturation vapour pressure at temperature, in Pa; the
+ * temperature is clamped to the table range
+ */
+uint16_t saturationPressure(int16_t temperature);
+
+/**
+ * @return the vapour pressure, in Pa
+ */
+uint16_t vapourPressure(int16_t temperature, uint16_t humidity);
+
+/**
+ * @return the vapour pressure deficit, saturation minus actual vapour
+ * pressure, in Pa
+ */
+uint16_t vapourPressureDeficit(int16_t temperature, uint16_t humidity);
+
+/**
+ * @return the temperature at which the air would saturate, in 0.1 C,
+ * clamped to the table range
+ */
+int16_t dewPoint(int16_t temperature, uint16_t humidity);
+
+/**
+ * @return the mass of water vapour per volume of air, in 0.1 g/m^3
+ */
+uint16_t absoluteHumidity(int16_t temperature, uint16_t humidity);
+
+/**
+ * @return the relative humidity that gives vpd (in Pa) at temperature, in
+ * 0.1 %RH, 0 if vpd is above the saturation pressure
+ */
+uint16_t humidityForDeficit(int16_t temperature, uint16_t vpd);
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ Recipe.cpp - Grow recipe: setpoints that follow the days since the start.
+*/
+
+#include "Recipe.h"
+
+#include <string.h>
+#include <CommandDispatcher.h>
+#include <Crc32.h>
+#include <SystemConfig.h>
+
+#define RECIPE_MAGIC    0x45504352UL  // "RCPE"
+#define RECIPE_VERSION  1
+#define RECIPE_FIELDS   8
+
+Recipe::Recipe() {
+  clear();
+}
+
+void Recipe::clear() {
+  count = 0;
+  memset(phases, 0, sizeof(phases));
+}
+
+bool Recipe::targets(uint32_t elapsed, RecipeTargets& out) const {
+  if (count == 0)
+    return false;
+
+  uint8_t i = 0;
+  uint32_t start = 0;
+  while (i < count - 1 && elapsed - start >= phases[i].hours * 3600UL) {
+    start += phases[i].hours * 3600UL;
+    i++;
+  }
+
+  const RecipePhase& p = phases[i];
+  uint32_t into = elapsed - start;
+  int16_t temperature = p.temperature;
+  int16_t humidity = p.humidity;
+  if (i > 0 && into < p.ramp * 3600UL) {
+    const RecipePhase& prev = phases[i - 1];
+    int64_t ramp = p.ramp * 3600UL;
+    temperature = prev.temperature + (int64_t)(p.temperature - prev.temperature) * into / ramp;
+    humidity = prev.humidity + (int64_t)(p.humidity - prev.humidity) * into / ramp;
+  }
+
+  out.phase = i;
+  out.done = into >= p.hours * 3600UL;
+  out.temperature = temperature;
+  out.humidity = humidity;
+  out.humidifierPeriod = p.humidifierPeriod;
+  out.humidifierActiveTime = p.humidifierActiveTime;
+  out.fans = p.fans;
+  return true;
+}
+
+bool parseRecipePhase(const uint8_t* payload, uint16_t length, uint8_t& index, RecipePhase& phase) {
+  static const int32_t maximum[RECIPE_FIELDS] = {
+    RECIPE_MAX_PHASES - 1, 65535, 65535, CONFIG_MAX_TEMPERATURE, CONFIG_MAX_HUMIDITY,
+    CONFIG_MAX_PERIOD, CONFIG_MAX_PERIOD * 60, RECIPE_FAN1 | RECIPE_FAN2
+  };
+  int32_t v[RECIPE_FIELDS];
+
+  uint16_t i = 0;
+  for (uint8_t f = 0; f < RECIPE_FIELDS; f++) {
+    uint16_t start = i;
+    while (i < length && payload[i] != ',')
+      i++;
+    if ((i == length) != (f == RECIPE_FIELDS - 1))
+      return false;
+
+    bool ok = (f == 3 || f == 4) ? parseDeci(payload + start, i - start, v[f])
+                                 : parseInt(payload + start, i - start, v[f]);
+    if (!ok || v[f] < 0 || v[f] > maximum[f])
+      return false;
+    i++;    // ','
+  }
+
+  if (v[1] == 0 || v[2] > v[1])
+    return false;
+  if (v[5] != 0 && v[6] > v[5] * 60)
+    return false;
+
+  index = v[0];
+  phase.hours = v[1];
+  phase.ramp = v[2];
+  phase.temperature = v[3];
+  phase.humidity = v[4];
+  phase.humidifierPeriod = v[5];
+  phase.humidifierActiveTime = v[6];
+  phase.fans = v[7];
+  return true;
+}
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+uint16_t encodeRecipe(const Recipe& recipe, uint8_t* buf) {
+  put32(buf, RECIPE_MAGIC);
+  buf[4] = RECIPE_VERSION;
+  buf[5] = recipe.count;
+
+  uint8_t* p = buf + 6;
+  for (uint8_t i = 0; i < recipe.count; i++, p += RECIPE_PHASE_SIZE) {
+    const RecipePhase& phase = recipe.phases[i];
+    put16(p, phase.hours);
+    put16(p + 2, phase.ramp);
+    put16(p + 4, phase.temperature);
+    put16(p + 6, phase.humidity);
+    put16(p + 8, phase.humidifierPeriod);
+    put16(p + 10, phase.humidifierActiveTime);
+    p[12] = phase.fans;
+    p[13] = 0;
+  }
+
+  put32(p, crc32(buf, p - buf));
+  return p - buf + 4;
+}
+
+bool decodeRecipe(const uint8_t* buf, uint16_t length, Recipe& recipe) {
+  if (length < 10 || get32(buf) != RECIPE_MAGIC || buf[4] != RECIPE_VERSION)
+    return false;
+  uint8_t count = buf[5];
+  if (count > RECIPE_MAX_PHASES || length != 10 + count * RECIPE_PHASE_SIZE)
+    return false;
+  if (get32(buf + length - 4) != crc32(buf, length - 4))
+    return false;
+
+  recipe.clear();
+  const uint8_t* p = buf + 6;
+  for (uint8_t i = 0; i < count; i++, p += RECIPE_PHASE_SIZE) {
+    RecipePhase& phase = recipe.phases[i];
+    phase.hours = get16(p);
+    phase.ramp = get16(p + 2);
+    phase.temperature = (int16_t)get16(p + 4);
+    phase.humidity = (int16_t)get16(p + 6);
+    phase.humidifierPeriod = get16(p + 8);
+    phase.humidifierActiveTime = get16(p + 10);
+    phase.fans = p[12];
+  }
+  recipe.count = count;
+  return true;
+}
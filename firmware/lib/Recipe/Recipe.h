@@ -0,0 +1,101 @@
+/*
+ Recipe.h - Grow recipe: setpoints that follow the days since the start.
+
+ A recipe is a table of up to RECIPE_MAX_PHASES phases run one after the
+ other from systemData.startEpochTime. Each phase sets the temperature and
+ humidity, the periodic humidifier pulse and which fans run. A phase with a
+ ramp moves its temperature and humidity linearly from the previous
+ phase's values during its first ramp hours instead of stepping. After the
+ last phase its setpoints are kept.
+
+ Phases are sent one per message on ESPID/set/recipe/phase as
+
+   index,hours,ramp,temperature,humidity,period,activetime,fans
+
+ for example "1,72,12,22.5,95,60,20,3": phase 1 lasts 72 h, ramps from
+ phase 0 over the first 12 h to 22.5 C and 95 %RH, pulses the humidifier
+ for 20 s every 60 min and runs both fans (bit 0 fan1, bit 1 fan2).
+*/
+
+#ifndef Recipe_h
+#define Recipe_h
+
+#include <stdint.h>
+
+#define RECIPE_MAX_PHASES   8
+#define RECIPE_PHASE_SIZE   14    // bytes of a phase in encodeRecipe()
+#define RECIPE_MAX_SIZE     (10 + RECIPE_MAX_PHASES * RECIPE_PHASE_SIZE)
+
+#define RECIPE_FAN1         0x01
+#define RECIPE_FAN2         0x02
+
+struct RecipePhase {
+  uint16_t  hours;                  // duration
+  uint16_t  ramp;                   // in hours, 0 steps to the setpoints
+  int16_t   temperature;            // in 0.1 C
+  int16_t   humidity;               // in 0.1 %RH
+  uint16_t  humidifierPeriod;       // in minutes
+  uint16_t  humidifierActiveTime;   // in seconds
+  uint8_t   fans;                   // RECIPE_FAN* bits
+};
+
+struct RecipeTargets {
+  uint8_t   phase;
+  bool      done;                   // past the end of the last phase
+  int16_t   temperature;            // in 0.1 C
+  int16_t   humidity;               // in 0.1 %RH
+  uint32_t  humidifierPeriod;       // in minutes
+  uint32_t  humidifierActiveTime;   // in seconds
+  uint8_t   fans;
+};
+
+class Recipe {
+  public:
+    Recipe();
+
+    void clear();
+
+    /**
+     * Computes the setpoints elapsed seconds after the start of the run.
+     *
+     * @return false if the recipe is empty
+     */
+    bool targets(uint32_t elapsed, RecipeTargets& out) const;
+
+    uint8_t     count;
+    RecipePhase phases[RECIPE_MAX_PHASES];
+};
+
+/**
+ * Parses an ESPID/set/recipe/phase payload. phase is only meaningful on
+ * success.
+ *
+ * @return false on a missing, malformed or out of range field, a ramp
+ * longer than the phase or an active time longer than the period
+ */
+bool parseRecipePhase(const uint8_t* payload, uint16_t length, uint8_t& index, RecipePhase& phase);
+
+/**
+ * Writes recipe for SPIFFS, little-endian:
+ *
+ *   offset  size  field
+ *        0     4  magic, "RCPE"
+ *        4     1  version, 1
+ *        5     1  count
+ *        6    14  phase, count times: hours, ramp, temperature, humidity,
+ *                 period, active time (2 bytes each), fans, 0
+ *   6 + 14 * count  4  CRC-32 of everything before it
+ *
+ * buf must hold RECIPE_MAX_SIZE bytes.
+ *
+ * @return the number of bytes written
+ */
+uint16_t encodeRecipe(const Recipe& recipe, uint8_t* buf);
+
+/**
+ * @return false if the magic, version, length or CRC is wrong; recipe is
+ * then left untouched
+ */
+bool decodeRecipe(const uint8_t* buf, uint16_t length, Recipe& recipe);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ RecipeStore.cpp - Keeps the grow recipe in SPIFFS.
+*/
+
+#include "RecipeStore.h"
+
+#include <FS.h>
+
+static bool readRecipe(const char* path, Recipe& recipe) {
+  File f = SPIFFS.open(path, "r");
+  if (!f)
+    return false;
+
+  uint8_t buf[RECIPE_MAX_SIZE + 1];
+  uint16_t length = f.read(buf, sizeof(buf));
+  f.close();
+  return decodeRecipe(buf, length, recipe);
+}
+
+// A reset between the remove and the rename leaves only the temporary file.
+bool loadRecipe(Recipe& recipe) {
+  return readRecipe(RECIPE_FILE, recipe) || readRecipe(RECIPE_TEMP_FILE, recipe);
+}
+
+bool saveRecipe(const Recipe& recipe) {
+  if (recipe.count == 0) {
+    SPIFFS.remove(RECIPE_TEMP_FILE);
+    SPIFFS.remove(RECIPE_FILE);
+    return true;
+  }
+
+  uint8_t buf[RECIPE_MAX_SIZE];
+  uint16_t length = encodeRecipe(recipe, buf);
+
+  File f = SPIFFS.open(RECIPE_TEMP_FILE, "w");
+  if (!f)
+    return false;
+  bool ok = f.write(buf, length) == length;
+  f.close();
+  if (!ok)
+    return false;
+
+  SPIFFS.remove(RECIPE_FILE);
+  return SPIFFS.rename(RECIPE_TEMP_FILE, RECIPE_FILE);
+}
@@ -0,0 +1,30 @@
+/*
+ RecipeStore.h - Keeps the grow recipe in SPIFFS.
+
+ The recipe is written to a temporary file that then replaces RECIPE_FILE,
+ so a write cut short by a reset leaves the previous recipe in place.
+ SPIFFS must already be mounted (see SettingsStore).
+*/
+
+#ifndef RecipeStore_h
+#define RecipeStore_h
+
+#include "Recipe.h"
+
+#define RECIPE_FILE       "/recipe"
+#define RECIPE_TEMP_FILE  "/recipe.tmp"
+
+/**
+ * @return false if there is no valid recipe file, recipe is then left
+ * untouched
+ */
+bool loadRecipe(Recipe& recipe);
+
+/**
+ * Stores recipe, an empty recipe removes the file.
+ *
+ * @return false if the file could not be written
+ */
+bool saveRecipe(const Recipe& recipe);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ ReportFilter.cpp - Decides when a telemetry field is worth publishing.
+*/
+
+#include "ReportFilter.h"
+
+ReportFilter::ReportFilter(uint32_t deadband) {
+  _deadband = deadband;
+  _last = 0;
+  _valid = false;
+}
+
+bool ReportFilter::changed(int32_t value) const {
+  if (!_valid)
+    return true;
+
+  uint32_t delta = (uint32_t)value - (uint32_t)_last;
+  if ((int32_t)delta < 0)
+    delta = -delta;
+
+  if (_deadband == 0)
+    return delta != 0;
+  return delta >= _deadband;
+}
+
+void ReportFilter::set(int32_t value) {
+  _last = value;
+  _valid = true;
+}
+
+void ReportFilter::setDeadband(uint32_t deadband) {
+  _deadband = deadband;
+}
+
+void ReportFilter::reset() {
+  _valid = false;
+}
@@ -0,0 +1,45 @@
+/*
+ ReportFilter.h - Decides when a telemetry field is worth publishing.
+
+ Keeps the last published value of one field. Values are integers: analog
+ readings are passed in the tenths they are carried in from the sensor on,
+ and epochs and counters are compared exactly too. A field is due when it moved by at least its
+ deadband since it was last published; with a deadband of 0 (digital
+ states, counters) any change is due. Callers force a publish on their
+ heartbeat interval and after reconnecting.
+*/
+
+#ifndef ReportFilter_h
+#define ReportFilter_h
+
+#include <stdint.h>
+
+class ReportFilter {
+  public:
+    ReportFilter(uint32_t deadband = 0);
+
+    /**
+     * @return true if value differs from the last published one by at least
+     * the deadband, or if nothing was published yet
+     */
+    bool changed(int32_t value) const;
+
+    /**
+     * Records value as published. Call it only once the publish succeeded.
+     */
+    void set(int32_t value);
+
+    void setDeadband(uint32_t deadband);
+
+    /**
+     * Forgets the last published value so the next update publishes.
+     */
+    void reset();
+
+  private:
+    uint32_t  _deadband;
+    int32_t   _last;
+    bool      _valid;
+};
+
+#endif
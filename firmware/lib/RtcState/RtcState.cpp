@@ -0,0 +1,42 @@
+/*
+ RtcState.cpp - Runtime state kept in RTC user memory across warm resets.
+*/
+
+#include "RtcState.h"
+
+#include <Arduino.h>
+#include <string.h>
+#include <Crc32.h>
+
+// "R", the version and the size. Records from before the version was added
+// carry "RT" (0x5254) in the upper half and never match.
+#define RTC_STATE_MAGIC (0x52000000UL | (uint32_t)RTC_STATE_VERSION << 16 | sizeof(RtcState))
+
+struct RtcBlock {
+  uint32_t  magic;
+  uint32_t  crc;
+  RtcState  state;
+};
+
+bool loadRtcState(RtcState& state) {
+  rst_info* info = ESP.getResetInfoPtr();
+  if (!info || info->reason == REASON_DEFAULT_RST)
+    return false;
+
+  RtcBlock block;
+  if (!ESP.rtcUserMemoryRead(RTC_STATE_OFFSET, (uint32_t*)&block, sizeof(block)))
+    return false;
+  if (block.magic != RTC_STATE_MAGIC || block.crc != crc32(&block.state, sizeof(block.state)))
+    return false;
+
+  memcpy(&state, &block.state, sizeof(state));
+  return true;
+}
+
+void saveRtcState(const RtcState& state) {
+  RtcBlock block;
+  block.magic = RTC_STATE_MAGIC;
+  memcpy(&block.state, &state, sizeof(block.state));
+  block.crc = crc32(&block.state, sizeof(block.state));
+  ESP.rtcUserMemoryWrite(RTC_STATE_OFFSET, (uint32_t*)&block, sizeof(block));
+}
@@ -0,0 +1,47 @@
+/*
+ RtcState.h - Runtime state kept in RTC user memory across warm resets.
+
+ The RTC user memory of the ESP8266 (512 bytes) survives watchdog and
+ exception resets, ESP.restart() and deep sleep, but not a power cycle.
+ The firmware mirrors its settings and the state the control loop builds
+ up over time there, so after a warm reset it continues where it stopped
+ instead of restarting the filters from 0 and reading flash.
+
+ The record carries a magic with RTC_STATE_VERSION and its size, and a
+ CRC-32, so memory left by a power-on is rejected. An OTA update ends in a
+ warm reset as well: RTC_STATE_VERSION must be bumped on every change of
+ RtcState or of the SystemData inside it, or the new firmware would read
+ the old layout.
+*/
+
+#ifndef RtcState_h
+#define RtcState_h
+
+#include <stdint.h>
+#include <SystemData.h>
+
+#define RTC_STATE_VERSION 1   // of the layout, see above
+#define RTC_STATE_OFFSET 0    // in 4 byte blocks of the user area
+#define RTC_ACTUATORS    4    // heater, humidifier, fan1, fan2
+
+struct RtcState {
+  SystemData  settings;
+  uint8_t     settingsDirty;    // settings not yet written to flash
+  uint8_t     flags;            // actuator outputs, see STATUS_FLAG_* in StatusSnapshot.h
+  int16_t     temperature;      // filter output, in 0.1 C
+  uint16_t    humidity;         // filter output, in 0.1 %RH
+  float       heaterIntegral;   // PID state
+  float       heaterFeedForward;  // model feed-forward in use, 0 if none
+  uint32_t    epoch;            // NTP time when the record was written
+  uint32_t    switches[RTC_ACTUATORS];
+  uint32_t    onTime[RTC_ACTUATORS];  // in s
+};
+
+/**
+ * @return true if the reset was a warm one and a valid record was found
+ */
+bool loadRtcState(RtcState& state);
+
+void saveRtcState(const RtcState& state);
+
+#endif
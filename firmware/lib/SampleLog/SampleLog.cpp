@@ -0,0 +1,153 @@
+/*
+ SampleLog.cpp - Bounded sample history in SPIFFS for offline periods.
+*/
+
+#include "SampleLog.h"
+
+#include <FS.h>
+
+#define SAMPLE_LOG_DIR "/log/"
+
+static uint8_t recordCheck(const uint8_t* r) {
+  uint8_t sum = 0;
+  for (uint8_t i = 0; i < SAMPLE_LOG_RECORD_SIZE - 1; i++)
+    sum += r[i];
+  return sum ^ 0xA5;
+}
+
+SampleLog::SampleLog() {
+  _first = 1;
+  _last = 0;
+  _readOffset = 0;
+  _batchEnd = 0;
+  _batchSize = 0;
+}
+
+void SampleLog::segmentName(uint32_t segment, char* name) {
+  sprintf(name, SAMPLE_LOG_DIR "%u", segment);
+}
+
+void SampleLog::begin() {
+  bool found = false;
+  Dir dir = SPIFFS.openDir(SAMPLE_LOG_DIR);
+  while (dir.next()) {
+    uint32_t segment = strtoul(dir.fileName().c_str() + strlen(SAMPLE_LOG_DIR), NULL, 10);
+    if (!found || segment < _first)
+      _first = segment;
+    if (!found || segment > _last)
+      _last = segment;
+    found = true;
+  }
+
+  // Segments are numbered without gaps, except if a reset happened while
+  // the oldest one was being removed; skip anything missing.
+  while (found && _first <= _last) {
+    char name[20];
+    segmentName(_first, name);
+    if (SPIFFS.exists(name))
+      break;
+    _first++;
+  }
+  _readOffset = 0;
+}
+
+bool SampleLog::empty() const {
+  return _first > _last;
+}
+
+void SampleLog::dropFirst() {
+  char name[20];
+  segmentName(_first, name);
+  SPIFFS.remove(name);
+  _first++;
+  _readOffset = 0;
+  _batchEnd = 0;
+}
+
+bool SampleLog::append(const LogSample& sample) {
+  char name[20];
+
+  if (empty()) {
+    _last++;
+    _first = _last;
+  } else {
+    segmentName(_last, name);
+    File f = SPIFFS.open(name, "r");
+    // A torn record at the end would misalign everything appended after it.
+    bool full = f && (f.size() >= SAMPLE_LOG_SEGMENT_RECORDS * SAMPLE_LOG_RECORD_SIZE
+                      || f.size() % SAMPLE_LOG_RECORD_SIZE != 0);
+    if (f)
+      f.close();
+    if (full) {
+      _last++;
+      if (_last - _first >= SAMPLE_LOG_SEGMENTS)
+        dropFirst();
+    }
+  }
+
+  uint8_t r[SAMPLE_LOG_RECORD_SIZE];
+  r[0] = sample.epoch;
+  r[1] = sample.epoch >> 8;
+  r[2] = sample.epoch >> 16;
+  r[3] = sample.epoch >> 24;
+  r[4] = (uint16_t)sample.temperature;
+  r[5] = (uint16_t)sample.temperature >> 8;
+  r[6] = sample.humidity;
+  r[7] = sample.humidity >> 8;
+  r[8] = sample.flags;
+  r[9] = recordCheck(r);
+
+  segmentName(_last, name);
+  File f = SPIFFS.open(name, "a");
+  if (!f)
+    return false;
+  size_t written = f.write(r, sizeof(r));
+  f.close();
+  return written == sizeof(r);
+}
+
+uint16_t SampleLog::readBatch(uint8_t* buf, uint8_t max) {
+  while (!empty()) {
+    char name[20];
+    segmentName(_first, name);
+    File f = SPIFFS.open(name, "r");
+    if (!f) {
+      dropFirst();
+      continue;
+    }
+
+    _batchSize = f.size();
+    f.seek(_readOffset, SeekSet);
+
+    uint8_t count = 0;
+    uint32_t offset = _readOffset;
+    uint8_t* r = buf + 2;
+    while (count < max && offset + SAMPLE_LOG_RECORD_SIZE <= _batchSize) {
+      if (f.read(r, SAMPLE_LOG_RECORD_SIZE) != SAMPLE_LOG_RECORD_SIZE)
+        break;
+      offset += SAMPLE_LOG_RECORD_SIZE;
+      if (r[9] != recordCheck(r))
+        continue;
+      r += SAMPLE_LOG_RECORD_SIZE;
+      count++;
+    }
+    f.close();
+    _batchEnd = offset;
+
+    if (count > 0) {
+      buf[0] = SAMPLE_LOG_VERSION;
+      buf[1] = count;
+      return SAMPLE_LOG_BATCH_SIZE(count);
+    }
+
+    // Nothing valid left in this segment.
+    dropFirst();
+  }
+  return 0;
+}
+
+void SampleLog::commit() {
+  _readOffset = _batchEnd;
+  if (_readOffset + SAMPLE_LOG_RECORD_SIZE > _batchSize)
+    dropFirst();
+}
@@ -0,0 +1,83 @@
+/*
+ SampleLog.h - Bounded sample history in SPIFFS for offline periods.
+
+ Samples are appended to numbered segment files (/log/<n>) of at most
+ SAMPLE_LOG_SEGMENT_RECORDS records. Only the newest segment is ever
+ written, and only by appending, so flash pages are not rewritten in place.
+ A replayed segment is deleted as a whole, and when SAMPLE_LOG_SEGMENTS
+ segments exist the oldest one is dropped to make room.
+
+ Record layout, 10 bytes, little-endian:
+
+   offset  size  field
+        0     4  epoch, uint32
+        4     2  temperature, int16, in 0.1 Celsius
+        6     2  humidity, uint16, in 0.1 %RH
+        8     1  flags, see STATUS_FLAG_* in StatusSnapshot.h
+        9     1  check, sum of bytes 0..8 xor 0xA5
+
+ A backfill payload is one version byte (SAMPLE_LOG_VERSION), one count
+ byte and count records, oldest first.
+*/
+
+#ifndef SampleLog_h
+#define SampleLog_h
+
+#include <stdint.h>
+
+#define SAMPLE_LOG_VERSION          1
+#define SAMPLE_LOG_RECORD_SIZE      10
+#define SAMPLE_LOG_SEGMENT_RECORDS  256
+#define SAMPLE_LOG_SEGMENTS         32    // 8192 samples, 80 kB of flash
+
+// Backfill payload size for a batch of n records.
+#define SAMPLE_LOG_BATCH_SIZE(n)    (2 + (n) * SAMPLE_LOG_RECORD_SIZE)
+
+struct LogSample {
+  uint32_t  epoch;
+  int16_t   temperature;    // in 0.1 Celsius
+  uint16_t  humidity;       // in 0.1 %RH
+  uint8_t   flags;
+};
+
+class SampleLog {
+  public:
+    SampleLog();
+
+    /**
+     * Finds the segments left by a previous run. SPIFFS must be mounted.
+     */
+    void begin();
+
+    bool append(const LogSample& sample);
+
+    bool empty() const;
+
+    /**
+     * Writes up to max of the oldest unsent records into buf as a backfill
+     * payload. buf must hold SAMPLE_LOG_BATCH_SIZE(max) bytes. Records that
+     * fail their check (torn writes) are skipped.
+     *
+     * @return the payload length, 0 if there is nothing to send
+     */
+    uint16_t readBatch(uint8_t* buf, uint8_t max);
+
+    /**
+     * Marks the records returned by the last readBatch() as sent. A sent
+     * segment is deleted. After a reset the current segment is replayed
+     * from its start, so the receiver must accept duplicates.
+     */
+    void commit();
+
+  private:
+    uint32_t  _first;       // oldest segment, the log is empty when _first > _last
+    uint32_t  _last;        // segment being written
+    uint32_t  _readOffset;  // in bytes, into _first
+    uint32_t  _batchEnd;    // _readOffset after commit()
+    uint32_t  _batchSize;   // size of _first when the last batch was read
+
+    void segmentName(uint32_t segment, char* name);
+    void dropFirst();
+};
+
+#endif
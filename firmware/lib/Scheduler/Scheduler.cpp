@@ -0,0 +1,116 @@
+/*
+ Scheduler.cpp - Deadline based cooperative task scheduler.
+*/
+
+#include "Scheduler.h"
+
+#include <string.h>
+
+Scheduler::Scheduler(SchedulerClock clock) {
+  _clock = clock;
+  _count = 0;
+  _started = false;
+}
+
+int8_t Scheduler::addTask(const char* name, TaskCallback callback, uint32_t periodMs, uint32_t offsetMs) {
+  if (_count >= SCHEDULER_MAX_TASKS)
+    return -1;
+
+  Task& t = _tasks[_count];
+  memset(&t, 0, sizeof(t));
+  t.name = name;
+  t.callback = callback;
+  t.period = periodMs * 1000;
+  t.enabled = true;
+
+  // Before the first run() the offset is kept in release and turned into an
+  // absolute time once the clock is read for the first time.
+  if (_started) {
+    t.release = (uint32_t)_clock() + offsetMs * 1000;
+    t.lastStart = t.release;
+  } else {
+    t.release = offsetMs * 1000;
+  }
+
+  return _count++;
+}
+
+void Scheduler::run() {
+  if (!_started) {
+    uint32_t now = _clock();
+    for (uint8_t i = 0; i < _count; i++) {
+      _tasks[i].release += now;
+      _tasks[i].lastStart = now;
+    }
+    _started = true;
+  }
+
+  for (uint8_t i = 0; i < _count; i++) {
+    Task& t = _tasks[i];
+    if (!t.enabled)
+      continue;
+
+    uint32_t start = _clock();
+    if (t.period != 0 && (int32_t)(start - t.release) < 0)
+      continue;
+
+    t.lastJitter = start - (t.period != 0 ? t.release : t.lastStart);
+    if (t.lastJitter > t.maxJitter)
+      t.maxJitter = t.lastJitter;
+    t.lastStart = start;
+
+    t.callback();
+
+    uint32_t duration = (uint32_t)_clock() - start;
+    if (duration > t.maxDuration)
+      t.maxDuration = duration;
+    t.runs++;
+
+    if (t.period != 0) {
+      t.release += t.period;
+      // Still behind after this run: drop the missed releases but stay on
+      // the original time grid.
+      if ((int32_t)(start - t.release) >= 0) {
+        uint32_t missed = (start - t.release) / t.period + 1;
+        t.overruns += missed;
+        t.release += missed * t.period;
+      }
+    }
+  }
+}
+
+void Scheduler::setEnabled(uint8_t index, bool enabled) {
+  if (index >= _count)
+    return;
+
+  Task& t = _tasks[index];
+  if (enabled && !t.enabled) {
+    t.release = _clock();
+    t.lastStart = t.release;
+  }
+  t.enabled = enabled;
+}
+
+void Scheduler::setPeriod(uint8_t index, uint32_t periodMs) {
+  if (index >= _count)
+    return;
+
+  _tasks[index].period = periodMs * 1000;
+}
+
+uint8_t Scheduler::taskCount() const {
+  return _count;
+}
+
+const Task& Scheduler::task(uint8_t index) const {
+  return _tasks[index];
+}
+
+void Scheduler::resetStats() {
+  for (uint8_t i = 0; i < _count; i++) {
+    _tasks[i].runs = 0;
+    _tasks[i].overruns = 0;
+    _tasks[i].maxJitter = 0;
+    _tasks[i].maxDuration = 0;
+  }
+}
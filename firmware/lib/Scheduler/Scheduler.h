@@ -0,0 +1,80 @@
+/*
+ Scheduler.h - Deadline based cooperative task scheduler.
+
+ Every task has a period and a release time. Scheduler::run() is called as
+ often as possible from loop() and starts every task whose release time has
+ passed, then moves that release forward by exactly one period, so a task
+ runs at a fixed rate instead of "period plus however long the work took".
+
+ All times are in microseconds as returned by the clock passed to the
+ constructor (micros() on the target). Periods are given in milliseconds
+ when the task is added.
+*/
+
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include <stdint.h>
+
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 16
+#endif
+
+typedef void (*TaskCallback)();
+typedef unsigned long (*SchedulerClock)();
+
+struct Task {
+  const char*   name;
+  TaskCallback  callback;
+  uint32_t      period;       // in us, 0 runs the task on every pass
+  uint32_t      release;      // next release time, in us
+  uint32_t      lastStart;    // in us
+  bool          enabled;
+
+  // Statistics, see Scheduler::resetStats()
+  uint32_t      runs;
+  uint32_t      overruns;     // releases dropped because the task was late by a full period
+  uint32_t      lastJitter;   // start time minus release time, in us (time
+                              // since the previous start for period 0 tasks)
+  uint32_t      maxJitter;    // in us
+  uint32_t      maxDuration;  // in us
+};
+
+class Scheduler {
+  public:
+    Scheduler(SchedulerClock clock);
+
+    /**
+     * Adds a task that runs every periodMs milliseconds. The first release
+     * happens offsetMs after the first call to run(), which can be used to
+     * stagger tasks sharing the same period.
+     *
+     * @return the task index, or -1 if the table is full
+     */
+    int8_t addTask(const char* name, TaskCallback callback, uint32_t periodMs, uint32_t offsetMs = 0);
+
+    /**
+     * Runs every task that is due. Tasks are started in the order they were
+     * added. Call this from loop() without any delay().
+     */
+    void run();
+
+    void setEnabled(uint8_t index, bool enabled);
+    void setPeriod(uint8_t index, uint32_t periodMs);
+
+    uint8_t     taskCount() const;
+    const Task& task(uint8_t index) const;
+
+    /**
+     * Clears runs, overruns and the maximum jitter and duration of every task.
+     */
+    void resetStats();
+
+  private:
+    SchedulerClock  _clock;
+    Task            _tasks[SCHEDULER_MAX_TASKS];
+    uint8_t         _count;
+    bool            _started;
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ SensorFusion.cpp - One temperature and humidity from several sensors.
+*/
+
+#include "SensorFusion.h"
+
+// Median of n values, sorting them in place; the mean of the middle two
+// for an even n.
+static int16_t median(int16_t* v, uint8_t n) {
+  for (uint8_t i = 1; i < n; i++) {
+    int16_t x = v[i];
+    uint8_t j = i;
+    for (; j > 0 && v[j - 1] > x; j--)
+      v[j] = v[j - 1];
+    v[j] = x;
+  }
+  return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static int32_t distance(int16_t a, int16_t b) {
+  return a > b ? (int32_t)a - b : (int32_t)b - a;
+}
+
+// Rounded to the nearest, halves away from 0.
+static int16_t divide(int64_t sum, uint32_t weight) {
+  return (sum >= 0 ? sum + weight / 2 : sum - weight / 2) / (int64_t)weight;
+}
+
+SensorFusion::SensorFusion(uint8_t count, uint8_t mode) {
+  _count = count < FUSION_MAX_SENSORS ? count : FUSION_MAX_SENSORS;
+  _mode = mode;
+  for (uint8_t i = 0; i < FUSION_MAX_SENSORS; i++) {
+    SensorHealth& s = _sensors[i];
+    s.temperature = 0;
+    s.humidity = 0;
+    s.lastGood = 0;
+    s.valid = false;
+    s.failures = 0;
+    s.errorRate = 0;
+    s.weight = 1;
+  }
+}
+
+void SensorFusion::setWeight(uint8_t index, uint8_t weight) {
+  if (index < _count)
+    _sensors[index].weight = weight;
+}
+
+void SensorFusion::update(uint8_t index, uint32_t now, bool ok, int16_t t, int16_t h) {
+  if (index >= _count)
+    return;
+
+  SensorHealth& s = _sensors[index];
+  int32_t target = ok ? 0 : 65535;
+  s.errorRate += ((target - s.errorRate) * FUSION_RATE_WEIGHT) >> 16;
+  if (!ok) {
+    if (s.failures < 255)
+      s.failures++;
+    return;
+  }
+  s.failures = 0;
+  s.temperature = t;
+  s.humidity = h;
+  s.lastGood = now;
+  s.valid = true;
+}
+
+bool SensorFusion::healthy(uint8_t index, uint32_t now) const {
+  const SensorHealth& s = _sensors[index];
+  return s.valid && now - s.lastGood <= FUSION_MAX_AGE
+         && s.failures < FUSION_MAX_FAILURES && s.errorRate < FUSION_MAX_ERROR_RATE;
+}
+
+uint8_t SensorFusion::fuse(uint32_t now, int16_t& t, int16_t& h) const {
+  uint8_t used[FUSION_MAX_SENSORS];
+  int16_t temperatures[FUSION_MAX_SENSORS];
+  int16_t humidities[FUSION_MAX_SENSORS];
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (!healthy(i, now))
+      continue;
+    used[n] = i;
+    temperatures[n] = _sensors[i].temperature;
+    humidities[n] = _sensors[i].humidity;
+    n++;
+  }
+  if (n == 0)
+    return 0;
+
+  int16_t mt = median(temperatures, n);
+  int16_t mh = median(humidities, n);
+  if (_mode == FUSION_MEDIAN || n == 1) {
+    t = mt;
+    h = mh;
+    return n;
+  }
+
+  // Weights are up to 255 * 255, so the sums need more than 32 bits.
+  int64_t st = 0, sh = 0;
+  uint32_t sw = 0;
+  uint8_t m = 0;
+  for (uint8_t k = 0; k < n; k++) {
+    const SensorHealth& s = _sensors[used[k]];
+    if (n >= 3 && (distance(s.temperature, mt) > FUSION_MAX_DEVIATION_T
+                   || distance(s.humidity, mh) > FUSION_MAX_DEVIATION_H))
+      continue;
+    uint32_t w = (uint32_t)s.weight * ((65535 - s.errorRate) >> 8);
+    st += (int64_t)w * s.temperature;
+    sh += (int64_t)w * s.humidity;
+    sw += w;
+    m++;
+  }
+  if (sw == 0) {
+    t = mt;
+    h = mh;
+    return n;
+  }
+  t = divide(st, sw);
+  h = divide(sh, sw);
+  return m;
+}
@@ -0,0 +1,82 @@
+/*
+ SensorFusion.h - One temperature and humidity from several sensors.
+
+ Every read of every sensor, good or failed, goes through update(). A
+ sensor is healthy while its last good reading is recent, it has not
+ failed FUSION_MAX_FAILURES times in a row and its failure rate (an
+ exponential average over about 65536 / FUSION_RATE_WEIGHT reads) is below
+ FUSION_MAX_ERROR_RATE. fuse() combines the last good readings of the
+ healthy sensors:
+
+   FUSION_MEDIAN    median of each channel; with three or more sensors one
+                    that reads wrong but passes the checksum is ignored
+   FUSION_WEIGHTED  average weighted by setWeight() and by how often the
+                    sensor succeeds; with three or more sensors readings
+                    further than FUSION_MAX_DEVIATION_* from the median are
+                    left out first
+
+ With a single sensor both give its reading. Readings are in 0.1 C and
+ 0.1 %RH as the DHT22 sends them and the fusion is integer arithmetic
+ only. There is no Arduino dependency, so it runs on the host as well.
+*/
+
+#ifndef SensorFusion_h
+#define SensorFusion_h
+
+#include <stdint.h>
+
+#define FUSION_MAX_SENSORS      4
+#define FUSION_MAX_AGE          30000   // in ms
+#define FUSION_MAX_FAILURES     3       // consecutive
+#define FUSION_MAX_ERROR_RATE   32768   // in 1/65536
+#define FUSION_RATE_WEIGHT      3277    // of a new read, in 1/65536
+#define FUSION_MAX_DEVIATION_T  20      // in 0.1 C
+#define FUSION_MAX_DEVIATION_H  100     // in 0.1 %RH
+
+#define FUSION_MEDIAN           0
+#define FUSION_WEIGHTED         1
+
+struct SensorHealth {
+  int16_t   temperature;    // last good reading, in 0.1 C
+  int16_t   humidity;       // last good reading, in 0.1 %RH
+  uint32_t  lastGood;       // in ms
+  bool      valid;          // there was a good reading
+  uint8_t   failures;       // in a row
+  uint16_t  errorRate;      // in 1/65536
+  uint8_t   weight;
+};
+
+class SensorFusion {
+  public:
+    SensorFusion(uint8_t count, uint8_t mode = FUSION_MEDIAN);
+
+    /**
+     * @param weight relative to the other sensors, 1 for all by default
+     */
+    void setWeight(uint8_t index, uint8_t weight);
+
+    /**
+     * Records a read of sensor index; t and h are ignored when ok is false.
+     *
+     * @param now time of the read, in ms
+     */
+    void update(uint8_t index, uint32_t now, bool ok, int16_t t, int16_t h);
+
+    bool healthy(uint8_t index, uint32_t now) const;
+
+    /**
+     * @return the number of sensors the result was made of, 0 if none is
+     * healthy and t and h were left untouched
+     */
+    uint8_t fuse(uint32_t now, int16_t& t, int16_t& h) const;
+
+    const SensorHealth& sensor(uint8_t index) const { return _sensors[index]; }
+    uint8_t count() const { return _count; }
+
+  private:
+    SensorHealth  _sensors[FUSION_MAX_SENSORS];
+    uint8_t       _count;
+    uint8_t       _mode;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ SettingsRecord.cpp - On-flash format of SystemData.
+*/
+
+#include "SettingsRecord.h"
+
+#include <math.h>
+#include <string.h>
+#include <Crc32.h>
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static void putFloat(uint8_t* p, float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  put32(p, bits);
+}
+
+// The setpoints and filter coefficients are scaled integers in SystemData
+// and floats in the units of the configuration in the record.
+static void putScaled(uint8_t* p, int32_t v, float scale) {
+  putFloat(p, v / scale);
+}
+
+static void putFilter(uint8_t* p, const FilterSettings& s) {
+  putScaled(p, s.smoothing, FILTER_SMOOTHING_ONE);
+  putScaled(p + 4, s.maxRate, 100);
+  putScaled(p + 8, s.processNoise, FILTER_NOISE_ONE);
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float getFloat(const uint8_t* p) {
+  uint32_t bits = get32(p);
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+// Rounded and clamped to min..max, NAN gives min.
+static int32_t toScaled(float v, float scale, int32_t min, int32_t max) {
+  v *= scale;
+  if (!(v > min))
+    return min;
+  if (v >= max)
+    return max;
+  return lroundf(v);
+}
+
+static int32_t getScaled(const uint8_t* p, float scale, int32_t min, int32_t max) {
+  return toScaled(getFloat(p), scale, min, max);
+}
+
+static void getFilter(const uint8_t* p, FilterSettings& s) {
+  s.smoothing = getScaled(p, FILTER_SMOOTHING_ONE, 0, FILTER_SMOOTHING_ONE);
+  s.maxRate = getScaled(p + 4, 100, 0, UINT16_MAX);
+  s.processNoise = getScaled(p + 8, FILTER_NOISE_ONE, 0, FILTER_MAX_VARIANCE);
+}
+
+static uint32_t recordCrc(const uint8_t* buf, uint16_t payloadLength) {
+  uint32_t crc = crc32(buf, 12);
+  return crc32(buf + SETTINGS_HEADER_SIZE, payloadLength, crc);
+}
+
+uint16_t encodeSettingsRecord(const SystemData& data, uint32_t sequence, uint8_t* buf) {
+  uint8_t* p = buf + SETTINGS_HEADER_SIZE;
+  p[0] = data.state;
+  putScaled(p + 1, data.setTemperature, 10);
+  putScaled(p + 5, data.setHumidity, 10);
+  put32(p + 9, data.startEpochTime);
+  put32(p + 13, data.humidifierPeriod);
+  put32(p + 17, data.humidifierActiveTime);
+  putFloat(p + 21, data.heaterKp);
+  putFloat(p + 25, data.heaterKi);
+  putFloat(p + 29, data.heaterKd);
+  put32(p + 33, data.heaterWindow);
+  putFilter(p + 37, data.temperatureFilter);
+  putFilter(p + 49, data.humidityFilter);
+  putScaled(p + 61, data.setVpd, 1000);
+
+  put32(buf, SETTINGS_RECORD_MAGIC);
+  put16(buf + 4, SETTINGS_RECORD_VERSION);
+  put16(buf + 6, SETTINGS_PAYLOAD_SIZE);
+  put32(buf + 8, sequence);
+  put32(buf + 12, recordCrc(buf, SETTINGS_PAYLOAD_SIZE));
+  return SETTINGS_RECORD_SIZE;
+}
+
+bool decodeSettingsRecord(const uint8_t* buf, uint16_t length, SystemData& data, uint32_t& sequence) {
+  if (length < SETTINGS_HEADER_SIZE || get32(buf) != SETTINGS_RECORD_MAGIC)
+    return false;
+
+  uint16_t version = get16(buf + 4);
+  uint16_t payloadLength = get16(buf + 6);
+  if (payloadLength > length - SETTINGS_HEADER_SIZE)
+    return false;
+  if (get32(buf + 12) != recordCrc(buf, payloadLength))
+    return false;
+
+  switch (version) {
+    case 1:
+      if (payloadLength != 21)
+        return false;
+      break;
+    case 2:
+      if (payloadLength != 37)
+        return false;
+      break;
+    case 3:
+      if (payloadLength != 61)
+        return false;
+      break;
+    case 4:
+      if (payloadLength != 65)
+        return false;
+      break;
+    default:
+      return false;
+  }
+
+  const uint8_t* p = buf + SETTINGS_HEADER_SIZE;
+  data.state = p[0];
+  data.setTemperature = getScaled(p + 1, 10, INT16_MIN, INT16_MAX);
+  data.setHumidity = getScaled(p + 5, 10, 0, UINT16_MAX);
+  data.startEpochTime = get32(p + 9);
+  data.humidifierPeriod = get32(p + 13);
+  data.humidifierActiveTime = get32(p + 17);
+  if (version >= 2) {
+    data.heaterKp = getFloat(p + 21);
+    data.heaterKi = getFloat(p + 25);
+    data.heaterKd = getFloat(p + 29);
+    data.heaterWindow = get32(p + 33);
+  }
+  if (version >= 3) {
+    getFilter(p + 37, data.temperatureFilter);
+    getFilter(p + 49, data.humidityFilter);
+  }
+  if (version >= 4)
+    data.setVpd = getScaled(p + 61, 1000, 0, UINT16_MAX);
+
+  sequence = get32(buf + 8);
+  return true;
+}
+
+bool decodeLegacySettings(const uint8_t* buf, uint16_t length, SystemData& data) {
+  if (length != SETTINGS_LEGACY_SIZE || buf[0] > 1)
+    return false;
+
+  float t = getFloat(buf + 4);
+  float h = getFloat(buf + 8);
+  if (!isfinite(t) || !isfinite(h))
+    return false;
+
+  data.state = buf[0];
+  data.setTemperature = toScaled(t, 10, INT16_MIN, INT16_MAX);
+  data.setHumidity = toScaled(h, 10, 0, UINT16_MAX);
+  data.startEpochTime = get32(buf + 12);
+  data.humidifierPeriod = get32(buf + 16);
+  data.humidifierActiveTime = get32(buf + 20);
+  return true;
+}
@@ -0,0 +1,82 @@
+/*
+ SettingsRecord.h - On-flash format of SystemData.
+
+ A record is a 16 byte header followed by the payload, little-endian:
+
+   offset  size  field
+        0     4  magic, "SDAT"
+        4     2  version, SETTINGS_RECORD_VERSION when written
+        6     2  payload length
+        8     4  sequence, incremented on every write
+       12     4  CRC-32 of bytes 0..11 and of the payload
+
+ Version 4 payload, 65 bytes (version 1 is the first 21 bytes, version 2
+ the first 37, version 3 the first 61):
+
+   offset  size  field
+        0     1  state
+        1     4  setTemperature, float, in Celsius
+        5     4  setHumidity, float, in %RH
+        9     4  startEpochTime
+       13     4  humidifierPeriod, in minutes
+       17     4  humidifierActiveTime, in seconds
+       21     4  heaterKp, float
+       25     4  heaterKi, float
+       29     4  heaterKd, float
+       33     4  heaterWindow, in seconds
+       37     4  temperatureFilter.smoothing, float
+       41     4  temperatureFilter.maxRate, float
+       45     4  temperatureFilter.processNoise, float
+       49     4  humidityFilter.smoothing, float
+       53     4  humidityFilter.maxRate, float
+       57     4  humidityFilter.processNoise, float
+       61     4  setVpd, float, in kPa
+
+ Fields are written one by one rather than as the in-memory struct, so a
+ change of SystemData does not change what is on flash: the setpoints and
+ filter coefficients, scaled integers in SystemData, are converted back to
+ the float units of the configuration. A new layout gets
+ a new version and decodeSettingsRecord() keeps reading the older ones.
+*/
+
+#ifndef SettingsRecord_h
+#define SettingsRecord_h
+
+#include <stdint.h>
+#include <SystemData.h>
+
+#define SETTINGS_RECORD_MAGIC       0x54414453UL  // "SDAT"
+#define SETTINGS_RECORD_VERSION     4
+#define SETTINGS_HEADER_SIZE        16
+#define SETTINGS_PAYLOAD_SIZE       65
+#define SETTINGS_RECORD_SIZE        (SETTINGS_HEADER_SIZE + SETTINGS_PAYLOAD_SIZE)
+#define SETTINGS_RECORD_MAX_SIZE    96    // largest record any version may read
+
+// systemData.txt of older firmware: the raw struct as laid out by the
+// ESP8266 compiler.
+#define SETTINGS_LEGACY_SIZE        24
+
+/**
+ * Writes data as a current version record. buf must hold
+ * SETTINGS_RECORD_SIZE bytes.
+ *
+ * @return the record size
+ */
+uint16_t encodeSettingsRecord(const SystemData& data, uint32_t sequence, uint8_t* buf);
+
+/**
+ * Reads a record of any known version. Fields an older version lacks are
+ * left untouched in data.
+ *
+ * @return false if the magic, length or CRC is wrong or the version unknown
+ */
+bool decodeSettingsRecord(const uint8_t* buf, uint16_t length, SystemData& data, uint32_t& sequence);
+
+/**
+ * Reads a legacy systemData.txt.
+ *
+ * @return false if the size is wrong or the values make no sense
+ */
+bool decodeLegacySettings(const uint8_t* buf, uint16_t length, SystemData& data);
+
+#endif
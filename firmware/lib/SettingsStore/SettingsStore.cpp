@@ -0,0 +1,159 @@
+/*
+ SettingsStore.cpp - SystemData persistence with write coalescing.
+*/
+
+#include "SettingsStore.h"
+
+#include <string.h>
+#include <FS.h>
+#include "SettingsRecord.h"
+
+static const char* slotNames[2] = { SETTINGS_SLOT_A, SETTINGS_SLOT_B };
+
+SettingsStore::SettingsStore(SystemData& data, uint32_t quietPeriodMs)
+  : _data(data) {
+  memset(&_stored, 0, sizeof(_stored));
+  _quietPeriod = quietPeriodMs;
+  _changedAt = 0;
+  _pending = false;
+  _mounted = false;
+  _writes = 0;
+  _sequence = 0;
+  _slot = 1;
+  _slotKnown = false;
+}
+
+bool SettingsStore::begin() {
+  _mounted = SPIFFS.begin();
+  if (!_mounted) {
+    _data.state = 0;
+    return false;
+  }
+
+  if (!findNewest(_data)) {
+    if (readLegacy()) {
+      if (writeRecord())
+        SPIFFS.remove(SETTINGS_LEGACY_FILE);
+    } else {
+      _data.state = 0;
+    }
+  }
+
+  memcpy(&_stored, &_data, sizeof(_stored));
+  return true;
+}
+
+bool SettingsStore::resume(bool dirty, uint32_t now) {
+  _mounted = SPIFFS.begin();
+  if (dirty) {
+    memset(&_stored, 0xFF, sizeof(_stored));    // differs from any settings
+    save(now);
+  } else {
+    memcpy(&_stored, &_data, sizeof(_stored));
+  }
+  return _mounted;
+}
+
+void SettingsStore::save(uint32_t now) {
+  _changedAt = now;
+  _pending = true;
+}
+
+bool SettingsStore::flush() {
+  _pending = false;
+  if (!dirty())
+    return true;
+  if (!_mounted)
+    return false;
+
+  if (!writeRecord()) {
+    _pending = true;    // run() tries again
+    return false;
+  }
+  memcpy(&_stored, &_data, sizeof(_stored));
+  return true;
+}
+
+void SettingsStore::run(uint32_t now) {
+  if (_pending && now - _changedAt >= _quietPeriod)
+    flush();
+}
+
+// Compared in the stored form: SystemData has padding, and only what the
+// record holds matters.
+bool SettingsStore::dirty() const {
+  uint8_t stored[SETTINGS_RECORD_SIZE], data[SETTINGS_RECORD_SIZE];
+  encodeSettingsRecord(_stored, 0, stored);
+  encodeSettingsRecord(_data, 0, data);
+  return memcmp(stored + SETTINGS_HEADER_SIZE, data + SETTINGS_HEADER_SIZE, SETTINGS_PAYLOAD_SIZE) != 0;
+}
+
+uint32_t SettingsStore::writes() const {
+  return _writes;
+}
+
+bool SettingsStore::findNewest(SystemData& data) {
+  bool found = false;
+  for (uint8_t slot = 0; slot < 2; slot++) {
+    SystemData candidate = data;
+    uint32_t sequence;
+    if (!readSlot(slot, candidate, sequence))
+      continue;
+    if (found && (int32_t)(sequence - _sequence) <= 0)
+      continue;
+    memcpy(&data, &candidate, sizeof(data));
+    _sequence = sequence;
+    _slot = slot;
+    found = true;
+  }
+  _slotKnown = true;
+  return found;
+}
+
+bool SettingsStore::readSlot(uint8_t slot, SystemData& data, uint32_t& sequence) {
+  File f = SPIFFS.open(slotNames[slot], "r");
+  if (!f)
+    return false;
+
+  uint8_t buf[SETTINGS_RECORD_MAX_SIZE];
+  uint16_t length = f.read(buf, sizeof(buf));
+  f.close();
+  return decodeSettingsRecord(buf, length, data, sequence);
+}
+
+bool SettingsStore::readLegacy() {
+  File f = SPIFFS.open(SETTINGS_LEGACY_FILE, "r");
+  if (!f)
+    return false;
+
+  uint8_t buf[SETTINGS_LEGACY_SIZE + 1];
+  uint16_t length = f.read(buf, sizeof(buf));
+  f.close();
+  return decodeLegacySettings(buf, length, _data);
+}
+
+// The record goes to the slot that does not hold the newest one, so a write
+// cut short by a reset leaves the previous record intact.
+bool SettingsStore::writeRecord() {
+  if (!_slotKnown) {
+    SystemData scratch = _data;
+    findNewest(scratch);
+  }
+
+  uint8_t slot = _slot ^ 1;
+  uint8_t buf[SETTINGS_RECORD_SIZE];
+  uint16_t length = encodeSettingsRecord(_data, _sequence + 1, buf);
+
+  File f = SPIFFS.open(slotNames[slot], "w");
+  if (!f)
+    return false;
+  bool ok = f.write(buf, length) == length;
+  f.close();
+  if (!ok)
+    return false;
+
+  _slot = slot;
+  _sequence++;
+  _writes++;
+  return true;
+}
@@ -0,0 +1,93 @@
+/*
+ SettingsStore.h - SystemData persistence with write coalescing.
+
+ Mounts SPIFFS once and keeps a copy of what was last written. Changes are
+ not written from the MQTT callback: save() only notes the time of the
+ change and run(), called from a task, writes once no change has come in
+ for the quiet period. A write is skipped when the settings are back to
+ what is already in flash, so a burst of retained set/ messages after a
+ reconnect costs at most one write. Changes that must survive an
+ immediate reset (starting or stopping a run) use flush().
+
+ Records (see SettingsRecord.h) are written alternately to two files. At
+ boot both are read and the valid one with the higher sequence wins, so a
+ write torn by a power loss falls back to the previous settings. A
+ systemData.txt left by older firmware is converted on the first boot.
+*/
+
+#ifndef SettingsStore_h
+#define SettingsStore_h
+
+#include <stdint.h>
+#include <SystemData.h>
+
+#define SETTINGS_SLOT_A       "/settings.a"
+#define SETTINGS_SLOT_B       "/settings.b"
+#define SETTINGS_LEGACY_FILE  "systemData.txt"
+
+class SettingsStore {
+  public:
+    SettingsStore(SystemData& data, uint32_t quietPeriodMs);
+
+    /**
+     * Mounts SPIFFS and loads the newest valid record. Without one the
+     * settings are left as they are, with state 0.
+     *
+     * @return false if SPIFFS could not be mounted
+     */
+    bool begin();
+
+    /**
+     * Mounts SPIFFS after a warm reset, with the settings already restored
+     * from RTC memory (see RtcState.h), without reading them from flash.
+     * If they had not been written yet, dirty schedules a write.
+     *
+     * @return false if SPIFFS could not be mounted
+     */
+    bool resume(bool dirty, uint32_t now);
+
+    /**
+     * Schedules a write of the settings quietPeriodMs after now, or after
+     * the last of several save() calls.
+     */
+    void save(uint32_t now);
+
+    /**
+     * Writes the settings right away if they differ from the stored ones.
+     *
+     * @return false if the write failed
+     */
+    bool flush();
+
+    /**
+     * Writes pending changes once the quiet period is over. Call it
+     * periodically.
+     */
+    void run(uint32_t now);
+
+    /**
+     * @return true if the settings differ from what is stored
+     */
+    bool dirty() const;
+
+    uint32_t writes() const;
+
+  private:
+    SystemData& _data;
+    SystemData  _stored;
+    uint32_t    _quietPeriod;   // in ms
+    uint32_t    _changedAt;     // in ms
+    bool        _pending;
+    bool        _mounted;
+    uint32_t    _writes;
+    uint32_t    _sequence;      // of the newest record
+    uint8_t     _slot;          // holding the newest record
+    bool        _slotKnown;     // false until the slots were read, see resume()
+
+    bool findNewest(SystemData& data);
+    bool readSlot(uint8_t slot, SystemData& data, uint32_t& sequence);
+    bool readLegacy();
+    bool writeRecord();
+};
+
+#endif
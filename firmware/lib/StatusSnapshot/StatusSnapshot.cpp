@@ -0,0 +1,64 @@
+/*
+ StatusSnapshot.cpp - All status fields of a node in one fixed binary record.
+*/
+
+#include "StatusSnapshot.h"
+
+static void put16(uint8_t* p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return p[0] | (uint16_t)p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint8_t encodeStatusSnapshot(const StatusSnapshot& s, uint8_t* buf) {
+  buf[0] = STATUS_SNAPSHOT_VERSION;
+  buf[1] = s.flags;
+  put16(buf + 2, (uint16_t)s.temperature);
+  put16(buf + 4, s.humidity);
+  put16(buf + 6, s.daysElapsed);
+  put32(buf + 8, s.startEpochTime);
+  put32(buf + 12, s.epoch);
+  put16(buf + 16, (uint16_t)s.dewPoint);
+  put16(buf + 18, s.vpd);
+  put16(buf + 20, s.absHumidity);
+  return STATUS_SNAPSHOT_SIZE;
+}
+
+bool decodeStatusSnapshot(const uint8_t* buf, unsigned int length, StatusSnapshot& s) {
+  if (length < STATUS_SNAPSHOT_V1_SIZE)
+    return false;
+  if (buf[0] == 1) {
+    s.dewPoint = 0;
+    s.vpd = 0;
+    s.absHumidity = 0;
+  } else if (buf[0] == 2 && length >= STATUS_SNAPSHOT_SIZE) {
+    s.dewPoint = (int16_t)get16(buf + 16);
+    s.vpd = get16(buf + 18);
+    s.absHumidity = get16(buf + 20);
+  } else {
+    return false;
+  }
+
+  s.version = buf[0];
+  s.flags = buf[1];
+  s.temperature = (int16_t)get16(buf + 2);
+  s.humidity = get16(buf + 4);
+  s.daysElapsed = get16(buf + 6);
+  s.startEpochTime = get32(buf + 8);
+  s.epoch = get32(buf + 12);
+  return true;
+}
@@ -0,0 +1,69 @@
+/*
+ StatusSnapshot.h - All status fields of a node in one fixed binary record.
+
+ Published on ESPID/status/snapshot in place of the text ESPID/status/...
+ topics when the firmware is built with STATUS_SNAPSHOT=1. Multi-byte
+ fields are little-endian:
+
+   offset  size  field
+        0     1  version (STATUS_SNAPSHOT_VERSION)
+        1     1  flags, see STATUS_FLAG_*
+        2     2  temperature, int16, in 0.1 Celsius
+        4     2  humidity, uint16, in 0.1 %RH
+        6     2  days elapsed since startEpochTime, uint16
+        8     4  startEpochTime, uint32
+       12     4  epoch of the sample, uint32
+       16     2  dew point, int16, in 0.1 Celsius (version 2)
+       18     2  vapour pressure deficit, uint16, in Pa (version 2)
+       20     2  absolute humidity, uint16, in 0.1 g/m^3 (version 2)
+
+ Newer versions only append fields, so a decoder accepts any payload at
+ least as long as the version it carries with a version it knows, and
+ ignores what follows.
+*/
+
+#ifndef StatusSnapshot_h
+#define StatusSnapshot_h
+
+#include <stdint.h>
+
+#define STATUS_SNAPSHOT_VERSION 2
+#define STATUS_SNAPSHOT_SIZE    22
+#define STATUS_SNAPSHOT_V1_SIZE 16
+
+#define STATUS_FLAG_HEATER      0x01
+#define STATUS_FLAG_HUMIDIFIER  0x02
+#define STATUS_FLAG_FAN1        0x04
+#define STATUS_FLAG_FAN2        0x08
+#define STATUS_FLAG_RUNNING     0x10  // systemData.state == 1
+
+struct StatusSnapshot {
+  uint8_t   version;
+  uint8_t   flags;
+  int16_t   temperature;    // in 0.1 Celsius
+  uint16_t  humidity;       // in 0.1 %RH
+  uint16_t  daysElapsed;
+  uint32_t  startEpochTime;
+  uint32_t  epoch;
+  int16_t   dewPoint;       // in 0.1 Celsius, version 2
+  uint16_t  vpd;            // in Pa, version 2
+  uint16_t  absHumidity;    // in 0.1 g/m^3, version 2
+};
+
+/**
+ * Writes the snapshot to buf, which must hold STATUS_SNAPSHOT_SIZE bytes.
+ * The version field is always written as STATUS_SNAPSHOT_VERSION.
+ *
+ * @return the number of bytes written
+ */
+uint8_t encodeStatusSnapshot(const StatusSnapshot& s, uint8_t* buf);
+
+/**
+ * Reads a snapshot received from the broker. The fields a version 1
+ * payload does not carry are set to 0.
+ *
+ * @return false if the payload is too short or has an unknown version
+ */
+bool decodeStatusSnapshot(const uint8_t* buf, unsigned int length, StatusSnapshot& s);
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ TelemetryEncoder.cpp - Status topics built once and printf-free value formatting.
+*/
+
+#include "TelemetryEncoder.h"
+
+#include <string.h>
+
+static const char* const fieldNames[FIELD_COUNT] = {
+  "temperature",
+  "humidity",
+  "elapsed",
+  "elapsed2",
+  "heater",
+  "humidifier",
+  "fan1",
+  "fan2",
+  "snapshot",
+  "backfill",
+  "dewpoint",
+  "vpd",
+  "abshumidity"
+};
+
+TelemetryEncoder::TelemetryEncoder() {
+  memset(_topics, 0, sizeof(_topics));
+}
+
+void TelemetryEncoder::begin(const char* id) {
+  size_t idLength = strlen(id);
+  if (idLength > TELEMETRY_ID_SIZE)
+    idLength = TELEMETRY_ID_SIZE;
+
+  for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+    char* p = _topics[i];
+    memcpy(p, id, idLength);
+    p += idLength;
+    memcpy(p, "/status/", 8);
+    p += 8;
+    strcpy(p, fieldNames[i]);
+  }
+}
+
+const char* TelemetryEncoder::topic(uint8_t field) const {
+  return _topics[field];
+}
+
+const char* TelemetryEncoder::fieldName(uint8_t field) {
+  return fieldNames[field];
+}
+
+uint8_t formatUnsigned(uint32_t value, char* out) {
+  char digits[10];
+  uint8_t n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+
+  for (uint8_t i = 0; i < n; i++)
+    out[i] = digits[n - 1 - i];
+  out[n] = 0;
+  return n;
+}
+
+uint8_t formatInt(int32_t value, char* out) {
+  if (value >= 0)
+    return formatUnsigned(value, out);
+
+  out[0] = '-';
+  return 1 + formatUnsigned(-(uint32_t)value, out + 1);
+}
+
+uint8_t formatDeci(int32_t value, char* out) {
+  uint8_t n = 0;
+  uint32_t magnitude = value;
+  if (value < 0) {
+    out[n++] = '-';
+    magnitude = -(uint32_t)value;
+  }
+
+  n += formatUnsigned(magnitude / 10, out + n);
+  out[n++] = '.';
+  out[n++] = '0' + magnitude % 10;
+  out[n] = 0;
+  return n;
+}
@@ -0,0 +1,79 @@
+/*
+ TelemetryEncoder.h - Status topics built once and printf-free value formatting.
+
+ begin() writes every ESPID/status/<field> topic into a fixed table, so
+ publishing a field costs a table lookup instead of a sprintf(). Values are
+ formatted from integers: analog readings are carried in tenths and printed
+ with one decimal without touching float or printf, which on the ESP8266
+ would pull in the soft-float printf code. Nothing here allocates.
+*/
+
+#ifndef TelemetryEncoder_h
+#define TelemetryEncoder_h
+
+#include <stdint.h>
+
+enum StatusField {
+  FIELD_TEMPERATURE,
+  FIELD_HUMIDITY,
+  FIELD_ELAPSED,
+  FIELD_ELAPSED2,
+  FIELD_HEATER,
+  FIELD_HUMIDIFIER,
+  FIELD_FAN1,
+  FIELD_FAN2,
+  FIELD_SNAPSHOT,
+  FIELD_BACKFILL,
+  FIELD_DEWPOINT,
+  FIELD_VPD,
+  FIELD_ABSHUMIDITY,
+  FIELD_COUNT
+};
+
+#define TELEMETRY_ID_SIZE     12  // longest ESPID kept, longer IDs are cut
+#define TELEMETRY_FIELD_SIZE  11  // strlen("temperature")
+#define TELEMETRY_TOPIC_SIZE  (TELEMETRY_ID_SIZE + 8 + TELEMETRY_FIELD_SIZE + 1)  // ID + "/status/" + field
+
+// Longest output of the format functions, including the terminating NUL.
+#define TELEMETRY_VALUE_SIZE  12
+
+class TelemetryEncoder {
+  public:
+    TelemetryEncoder();
+
+    /**
+     * Builds the topic table for the given node ID.
+     */
+    void begin(const char* id);
+
+    const char* topic(uint8_t field) const;
+
+    static const char* fieldName(uint8_t field);
+
+  private:
+    char _topics[FIELD_COUNT][TELEMETRY_TOPIC_SIZE];
+};
+
+/**
+ * Writes a value in tenths as a decimal number with one digit after the
+ * point ("-12.3"), like sprintf("%.1f", value / 10.0).
+ *
+ * @return the length of the string, out must hold TELEMETRY_VALUE_SIZE bytes
+ */
+uint8_t formatDeci(int32_t value, char* out);
+
+/**
+ * Writes a signed integer, like sprintf("%d").
+ *
+ * @return the length of the string, out must hold TELEMETRY_VALUE_SIZE bytes
+ */
+uint8_t formatInt(int32_t value, char* out);
+
+/**
+ * Writes an unsigned integer, like sprintf("%u").
+ *
+ * @return the length of the string, out must hold TELEMETRY_VALUE_SIZE bytes
+ */
+uint8_t formatUnsigned(uint32_t value, char* out);
+
+#endif
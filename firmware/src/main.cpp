@@ -5,6 +5,24 @@
 #include <NTPClient.h>
 #include <WiFiUdp.h>
 #include <FS.h>
+#include <Scheduler.h>
+#include <Controller.h>
+#include <SystemConfig.h>
+#include <StatusSnapshot.h>
+#include <ReportFilter.h>
+#include <TelemetryEncoder.h>
+#include <SampleLog.h>
+#include <Aggregator.h>
+#include <CommandDispatcher.h>
+#include <SettingsStore.h>
+#include <RtcState.h>
+#include <Actuator.h>
+#include <SensorFusion.h>
+#include <Psychrometrics.h>
+#include <Recipe.h>
+#include <RecipeStore.h>
+#include <OutputSchedule.h>
+#include <ScheduleStore.h>
 
 const char* SSID = "RedePI3"; //Seu SSID da Rede WIFI
 const char* PASSWORD = "noisqtapi3"; // A Senha da Rede WIFI
@@ -24,48 +42,190 @@ int         PORT = 18650;
 #define GPIO_PIN_FAN1       15  // Circulação de Ar
 #define GPIO_PIN_FAN2       13  // Entrada de Ar
 
+// A fan relay stays at least this long in a state before it may switch
+// again; the heater and humidifier times are in Controller.h.
+#define FAN_MIN_ON          60000 // in ms
+#define FAN_MIN_OFF         60000 // in ms
+
 #define DHTPIN 2
 #define DHTTYPE DHT22
 #define REPORT_INTERVAL 5 // in sec
 
-#define TEMPERATURE_SMOOTHING_CONSTANT  0.4
-#define HUMIDITY_SMOOTHING_CONSTANT     0.8
-
-DHT           dht(DHTPIN, DHTTYPE);
+// 1 publishes all status fields as one binary record on ESPID/status/snapshot
+// (see lib/StatusSnapshot) instead of the text topics.
+#ifndef STATUS_SNAPSHOT
+#define STATUS_SNAPSHOT 0
+#endif
+
+// Status fields are only published when they change by at least their
+// deadband (in 0.1 units), and all of them every HEARTBEAT_INTERVAL.
+#define TEMPERATURE_DEADBAND  2   // 0.2 C
+#define HUMIDITY_DEADBAND     10  // 1.0 %RH
+#define DEWPOINT_DEADBAND     2   // 0.2 C
+#define VPD_DEADBAND          20  // in Pa, not 0.1 units
+#define ABSHUMIDITY_DEADBAND  2   // 0.2 g/m^3
+#define HEARTBEAT_INTERVAL    300 // in sec
+
+#define NETWORK_INTERVAL    5000  // in ms, WiFi and broker reconnection attempts
+#define SENSOR_INTERVAL     5000  // in ms
+#define SENSOR_MAX_AGE      30000 // in ms, the heater stays off on older readings
+#define SENSOR_REPORT_INTERVAL 60000 // in ms
+#define CONTROL_INTERVAL    5000  // in ms
+#define NTP_INTERVAL        60000 // in ms
+#define SCHED_STATS_INTERVAL 60000 // in ms
+#define MODEL_REPORT_INTERVAL 600000 // in ms, the thermal model adds a sample every 10 min
+#define ACTUATOR_REPORT_INTERVAL 60000 // in ms
+
+// While the broker is unreachable a sample is stored in SPIFFS every
+// OFFLINE_LOG_INTERVAL and replayed on ESPID/status/backfill after the
+// connection is back, BACKFILL_BATCH samples every BACKFILL_INTERVAL.
+#define OFFLINE_LOG_INTERVAL  30    // in sec
+#define BACKFILL_INTERVAL     1000  // in ms
+#define BACKFILL_BATCH        8
+
+// Every sensor reading also feeds min/max/mean/stddev and actuator duty
+// statistics that are published once per window on ESPID/status/agg/<sec>.
+#define AGG_WINDOW_SHORT  60    // in sec
+#define AGG_WINDOW_LONG   3600  // in sec
+#define AGG_WINDOWS       2
+
+// Setting changes are written to flash once no other change came in for
+// SETTINGS_QUIET_PERIOD, starting and stopping a run is written at once.
+#define SETTINGS_QUIET_PERIOD 3000  // in ms
+#define PERSIST_INTERVAL      1000  // in ms, also mirrors the runtime state to RTC memory
+
+#define MIN_VALID_EPOCH       1500000000UL  // earlier epochs mean NTP never synced
+
+// Time of day schedules run on local time.
+#define UTC_OFFSET            (-3 * 3600)   // in s
+
+// One entry per sensor, each on its own GPIO, for example
+// { {2, DHT22}, {4, DHT22} } for one at the top and one at the bottom of
+// the box. Reads are spread evenly over SENSOR_INTERVAL and fused with
+// FUSION_MODE, see lib/SensorFusion.
+DHT           dhtSensors[] = { {DHTPIN, DHTTYPE} };
+#define DHT_SENSORS   (sizeof(dhtSensors) / sizeof(dhtSensors[0]))
+#define FUSION_MODE   FUSION_MEDIAN
+SensorFusion  fusion(DHT_SENSORS, FUSION_MODE);
+uint8_t       nextSensor = 0;
+uint32_t      lastReading = 0;  // time of the last fused reading, in ms
 WiFiClient    CLIENT;
 WiFiUDP       ntpUDP;
 PubSubClient  MQTT(CLIENT);
 NTPClient     timeClient(ntpUDP);
-char      espID[6];
+Scheduler     scheduler(micros);
+SystemData    systemData;
+SystemData    activeData;     // systemData with the recipe applied, what the controller runs on
+Controller    controller(activeData);
+SettingsStore settings(systemData, SETTINGS_QUIET_PERIOD);
+TelemetryEncoder telemetry;
+SampleLog     sampleLog;
+WindowAggregator aggregates[AGG_WINDOWS] = {
+  WindowAggregator(AGG_WINDOW_SHORT),
+  WindowAggregator(AGG_WINDOW_LONG)
+};
+char          aggTopic[AGG_WINDOWS][TELEMETRY_TOPIC_SIZE];
+CommandDispatcher commands;
+Recipe        recipe;
+Recipe        recipeDraft;    // phases received on ESPID/set/recipe/phase
+uint8_t       recipeDraftPhases = 0;  // bit i set once phase i was received
+RecipeTargets recipeTargets;
+bool          recipeActive = false;
+uint8_t       activeFans = RECIPE_FAN1 | RECIPE_FAN2;
+OutputSchedule fan1Schedule;
+OutputSchedule fan2Schedule;
+// In the order they are stored in SPIFFS.
+#define SCHEDULES 3
+OutputSchedule* schedules[SCHEDULES] = { &controller.humidifierSchedule, &fan1Schedule, &fan2Schedule };
+Actuator      heaterOutput("heater", GPIO_PIN_HEATER, HEATER_MIN_ON, HEATER_MIN_OFF);
+Actuator      humidifierOutput("humidifier", GPIO_PIN_HUMIDIFIER, HUMIDIFIER_MIN_ON, HUMIDIFIER_MIN_OFF);
+Actuator      fan1Output("fan1", GPIO_PIN_FAN1, FAN_MIN_ON, FAN_MIN_OFF);
+Actuator      fan2Output("fan2", GPIO_PIN_FAN2, FAN_MIN_ON, FAN_MIN_OFF);
+// In the order of the STATUS_FLAG_* bits.
+Actuator*     actuators[RTC_ACTUATORS] = { &heaterOutput, &humidifierOutput, &fan1Output, &fan2Output };
+ReportFilter  temperatureReport(TEMPERATURE_DEADBAND);
+ReportFilter  humidityReport(HUMIDITY_DEADBAND);
+ReportFilter  dewPointReport(DEWPOINT_DEADBAND);
+ReportFilter  vpdReport(VPD_DEADBAND);
+ReportFilter  absHumidityReport(ABSHUMIDITY_DEADBAND);
+ReportFilter  elapsedReport;
+ReportFilter  elapsed2Report;
+ReportFilter  heaterReport;
+ReportFilter  humidifierReport;
+ReportFilter  fan1Report;
+ReportFilter  fan2Report;
+ReportFilter  recipeReport;
+char      espID[7];
 long      lastMsg = 0;
+uint32_t  lastHeartbeat = 0;
+uint32_t  lastOfflineSample = 0;
+bool      forceReport = true;
 char      msg[50];
-float     temperature = 0;
-float     humidity = 0;
-uint32_t  humidifierEpoch = 0;
-
-struct systemData {
-    uint8_t   state;
-    float     setTemperature;
-    float     setHumidity;
-    uint32_t  startEpochTime;
-    uint32_t  humidifierPeriod;       // in minutes
-    uint32_t  humidifierActiveTime;   // in seconds
-} systemData;
-
-void processSensors();
+
+void processSensor(uint8_t index);
+void processSensors(uint32_t now);
+void aggregate(int16_t t, int16_t h);
+void sendAggregate(uint8_t index);
+void resetAggregates();
+void applyRecipe();
+void sendRecipeStatus(bool force);
 void processActuators();
 void processHeater();
 void processHumidifier();
 void processFan1();
 void processFan2();
+bool processFan(OutputSchedule& schedule, bool enabled);
+uint32_t localTime();
 void setupWIFI();
 void reconectar();
 void setupPin();
 void setupSubscriptions();
 void sendStatus();
-void loadSystemData();
-void saveSystemData();
+void sendSnapshot(bool force);
+bool publishStatus(uint8_t field, const char* payload, ReportFilter& report, int32_t value);
+uint8_t statusFlags();
+void logSample();
+void taskBackfill();
+void taskPersist();
+void resumeState(const RtcState& rtc);
+void mirrorState();
 void callback(char* topic, byte* payload, unsigned int length);
+void setupCommands();
+void cmdState(const uint8_t* payload, uint16_t length);
+void cmdTemperature(const uint8_t* payload, uint16_t length);
+void cmdHumidity(const uint8_t* payload, uint16_t length);
+void cmdVpd(const uint8_t* payload, uint16_t length);
+void cmdHumidifierPeriod(const uint8_t* payload, uint16_t length);
+void cmdHumidifierActiveTime(const uint8_t* payload, uint16_t length);
+void cmdConfig(const uint8_t* payload, uint16_t length);
+void cmdHeaterKp(const uint8_t* payload, uint16_t length);
+void cmdHeaterKi(const uint8_t* payload, uint16_t length);
+void cmdHeaterKd(const uint8_t* payload, uint16_t length);
+void cmdHeaterWindow(const uint8_t* payload, uint16_t length);
+void cmdRecipe(const uint8_t* payload, uint16_t length);
+void cmdRecipePhase(const uint8_t* payload, uint16_t length);
+void cmdSchedule(OutputSchedule& schedule, const uint8_t* payload, uint16_t length);
+void cmdMaxDuty(OutputSchedule& schedule, const uint8_t* payload, uint16_t length);
+void cmdHumidifierSchedule(const uint8_t* payload, uint16_t length);
+void cmdHumidifierMaxDuty(const uint8_t* payload, uint16_t length);
+void cmdFan1Schedule(const uint8_t* payload, uint16_t length);
+void cmdFan1MaxDuty(const uint8_t* payload, uint16_t length);
+void cmdFan2Schedule(const uint8_t* payload, uint16_t length);
+void cmdFan2MaxDuty(const uint8_t* payload, uint16_t length);
+void saveOutputSchedules();
+void stopOutputs();
+void setupTasks();
+void taskNetwork();
+void taskMQTT();
+void taskSensors();
+void taskDHT();
+void taskControl();
+void taskTelemetry();
+void taskNTP();
+void sendSchedulerStats();
+void sendModel();
+void sendActuatorStats();
+void sendSensorStats();
 
 
 void setup(void) {
@@ -76,21 +236,73 @@ void setup(void) {
   WiFi.macAddress(temp);
   sprintf(espID, "%X%X%X", temp[3], temp[4], temp[5]);
   Serial.println(espID);
+  telemetry.begin(espID);
+  for (uint8_t i = 0; i < AGG_WINDOWS; i++)
+    sprintf(aggTopic[i], "%s/status/agg/%u", espID, aggregates[i].window());
+  setupCommands();
 
   MQTT.setServer(MQTT_SERVER, PORT);
   MQTT.setCallback(callback);
 
   setupPin();
 
-  dht.begin();
-
-  loadSystemData();
+  for (uint8_t i = 0; i < DHT_SENSORS; i++)
+    dhtSensors[i].begin();
+
+  // After a warm reset the settings come from RTC memory, flash is only
+  // read on a cold boot.
+  defaultSystemData(systemData);
+  RtcState rtc;
+  bool warm = loadRtcState(rtc);
+  bool mounted;
+  if(warm){
+    systemData = rtc.settings;
+    mounted = settings.resume(rtc.settingsDirty, millis());
+  } else {
+    mounted = settings.begin();
+  }
+  if(mounted)
+    Serial.println("SPIFFS Initialize....ok");
+  else
+    Serial.println("SPIFFS Initialization...failed");
+  sampleLog.begin();
+  if(loadSchedules(schedules, SCHEDULES))
+    Serial.println("schedules loaded");
+  if(loadRecipe(recipe)){
+    Serial.print("recipe loaded, phases: ");
+    Serial.println(recipe.count);
+  }
 
   timeClient.begin();
+  if(warm)
+    resumeState(rtc);
+
+  setupTasks();
 }
 
 void loop(void) {
+  scheduler.run();
+}
+
+// The tasks sharing the same period are staggered so that a single pass of
+// the scheduler never runs sensors, control and telemetry back to back.
+void setupTasks(){
+  scheduler.addTask("network",   taskNetwork,   NETWORK_INTERVAL);
+  scheduler.addTask("mqtt",      taskMQTT,      0);
+  scheduler.addTask("sensors",   taskSensors,   SENSOR_INTERVAL / DHT_SENSORS, 100);
+  scheduler.addTask("dht",       taskDHT,       0);
+  scheduler.addTask("control",   taskControl,   CONTROL_INTERVAL, 200);
+  scheduler.addTask("telemetry", taskTelemetry, 1000 * REPORT_INTERVAL, 300);
+  scheduler.addTask("ntp",       taskNTP,       NTP_INTERVAL, 400);
+  scheduler.addTask("stats",     sendSchedulerStats, SCHED_STATS_INTERVAL, 500);
+  scheduler.addTask("backfill",  taskBackfill,  BACKFILL_INTERVAL, 600);
+  scheduler.addTask("persist",   taskPersist,   PERSIST_INTERVAL, 700);
+  scheduler.addTask("model",     sendModel,     MODEL_REPORT_INTERVAL, 800);
+  scheduler.addTask("actuators", sendActuatorStats, ACTUATOR_REPORT_INTERVAL, 900);
+  scheduler.addTask("sensorstats", sendSensorStats, SENSOR_REPORT_INTERVAL, 1000);
+}
 
+void taskNetwork(){
   if (WiFi.status() != WL_CONNECTED) {
     setupWIFI();
   }
@@ -98,28 +310,328 @@ void loop(void) {
   if (!MQTT.connected()) {
     reconectar();
   }
-  MQTT.loop();
+}
 
-  if (systemData.state == 1)
-  {
-    processSensors();
-    processActuators();
+void taskMQTT(){
+  if (MQTT.connected())
+    MQTT.loop();
+}
+
+// Starts a read of the next sensor; taskDHT hands the result to
+// processSensor about 5 ms later. Each sensor is read every SENSOR_INTERVAL.
+void taskSensors(){
+  if (systemData.state != 1)
+    return;
+
+  dhtSensors[nextSensor].start();
+  nextSensor = (nextSensor + 1) % DHT_SENSORS;
+}
+
+void taskDHT(){
+  for (uint8_t i = 0; i < DHT_SENSORS; i++)
+    if (dhtSensors[i].poll() && systemData.state == 1)
+      processSensor(i);
+}
+
+void taskControl(){
+  if (systemData.state != 1)
+    return;
+
+  applyRecipe();
+  processActuators();
+}
+
+void taskTelemetry(){
+  if (systemData.state != 1)
+    return;
+
+  if (MQTT.connected())
     sendStatus();
+  else
+    logSample();
+}
+
+void taskBackfill(){
+  if (!MQTT.connected() || sampleLog.empty())
+    return;
+
+  uint8_t buff[SAMPLE_LOG_BATCH_SIZE(BACKFILL_BATCH)];
+  uint16_t length = sampleLog.readBatch(buff, BACKFILL_BATCH);
+  if (length != 0 && MQTT.publish(telemetry.topic(FIELD_BACKFILL), buff, length, false))
+    sampleLog.commit();
+}
+
+void taskPersist(){
+  settings.run(millis());
+  mirrorState();
+}
+
+// Picks the control loop up where it was before a warm reset: filter
+// states, PID, clock and outputs. The schedules follow the clock and need
+// no state. The thermal model starts over, so its last feed-forward is held
+// until the new fit is valid.
+void resumeState(const RtcState& rtc){
+  controller.setReadings(rtc.temperature, rtc.humidity);
+  controller.resumeHeater(rtc.heaterIntegral, rtc.heaterFeedForward);
+  if(rtc.epoch >= MIN_VALID_EPOCH)
+    timeClient.setEpochTime(rtc.epoch);
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < RTC_ACTUATORS; i++) {
+    if(systemData.state == 1)
+      actuators[i]->force(rtc.flags & (1 << i), now);
+    actuators[i]->restoreStats(rtc.switches[i], rtc.onTime[i]);
+  }
+  Serial.println("warm reset, state restored from RTC memory");
+}
+
+void mirrorState(){
+  RtcState rtc;
+  memset(&rtc, 0, sizeof(rtc));
+  rtc.settings = systemData;
+  rtc.settingsDirty = settings.dirty();
+  rtc.flags = statusFlags();
+  rtc.temperature = controller.temperature;
+  rtc.humidity = controller.humidity;
+  rtc.heaterIntegral = controller.heaterPid.integral;
+  rtc.heaterFeedForward = controller.heaterFeedForward();
+  rtc.epoch = timeClient.getEpochTime();
+  for (uint8_t i = 0; i < RTC_ACTUATORS; i++) {
+    rtc.switches[i] = actuators[i]->switches();
+    rtc.onTime[i] = actuators[i]->onTime(millis());
+  }
+  saveRtcState(rtc);
+}
+
+void taskNTP(){
+  timeClient.update();
+}
+
+// Publishes "runs,overruns,maxJitter,maxDuration" (times in us) for every
+// task and starts a new measurement window.
+void sendSchedulerStats(){
+  char topic[40];
+  for (uint8_t i = 0; i < scheduler.taskCount(); i++) {
+    const Task& t = scheduler.task(i);
+    sprintf(msg, "%u,%u,%u,%u", t.runs, t.overruns, t.maxJitter, t.maxDuration);
+    sprintf(topic, "%s/status/sched/%s", espID, t.name);
+    MQTT.publish(topic, msg, true);
+  }
+  scheduler.resetStats();
+}
+
+// Publishes "switches,ontime,duty" for every actuator on
+// ESPID/status/actuator/<name>: switches and on-time in s since boot (kept
+// across warm resets), duty in percent since the previous report.
+void sendActuatorStats(){
+  char topic[TELEMETRY_TOPIC_SIZE + 8];
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < RTC_ACTUATORS; i++) {
+    Actuator& a = *actuators[i];
+    sprintf(msg, "%u,%u,%u", a.switches(), a.onTime(now), a.duty(now));
+    sprintf(topic, "%s/status/actuator/%s", espID, a.name());
+    if(MQTT.connected())
+      MQTT.publish(topic, msg, true);
+    a.restartDuty(now);
+  }
+}
+
+// Publishes "temperature,humidity,healthy,reads,timeouts,pulse,checksum,
+// retries,errors" for every DHT on ESPID/status/sensor/<index>: its last
+// good reading in 0.1 units (empty before the first one), 1 if the fusion
+// uses it, counts since boot, then the percentage of failed transactions
+// since the previous report.
+void sendSensorStats(){
+  static DhtStats last[DHT_SENSORS];
+  char topic[TELEMETRY_TOPIC_SIZE + 4];
+  char payload[112];
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < DHT_SENSORS; i++) {
+    const DhtStats& s = dhtSensors[i].stats();
+    const SensorHealth& health = fusion.sensor(i);
+    uint32_t reads = s.reads - last[i].reads;
+    uint32_t errors = s.timeouts + s.pulseErrors + s.checksumErrors
+                      - last[i].timeouts - last[i].pulseErrors - last[i].checksumErrors;
+    last[i] = s;
+
+    char* p = payload;
+    if (health.valid) {
+      p += formatDeci(health.temperature, p);
+      *p++ = ',';
+      p += formatDeci(health.humidity, p);
+    } else {
+      *p++ = ',';
+    }
+    sprintf(p, ",%u,%u,%u,%u,%u,%u,%u", fusion.healthy(i, now), s.reads, s.timeouts,
+            s.pulseErrors, s.checksumErrors, s.retries, reads == 0 ? 0 : errors * 100 / reads);
+    sprintf(topic, "%s/status/sensor/%u", espID, i);
+    if(MQTT.connected())
+      MQTT.publish(topic, payload, true);
+  }
+}
+
+void processSensor(uint8_t index){
+  DhtSample s = dhtSensors[index].sample();
+  fusion.update(index, s.timestamp, s.ok(), s.temperature, s.humidity);
+  if (!s.ok()) {
+    Serial.print("DHT ");
+    Serial.print(index);
+    Serial.print(" error ");
+    Serial.println(s.status);
   }
 
-  delay(1000 * REPORT_INTERVAL);
+  // The controller gets one fused reading per round, after the last sensor.
+  if (index == DHT_SENSORS - 1)
+    processSensors(s.timestamp);
+}
+
+void processSensors(uint32_t now){
+  int16_t t, h;
+  if (fusion.fuse(now, t, h) == 0)
+    return;
 
+  lastReading = now;
+  controller.processSensors(now, t, h);
+  aggregate(t, h);
 }
 
-void processSensors(){
-  float h = dht.readHumidity();
-  float t = dht.readTemperature();
+// Windows that close while the broker is unreachable are dropped, the raw
+// samples are still covered by the offline log.
+void aggregate(int16_t t, int16_t h){
+  uint32_t now = millis();
+  uint8_t flags = statusFlags();
+
+  for (uint8_t i = 0; i < AGG_WINDOWS; i++) {
+    aggregates[i].add(now, t, h, flags);
+    if (!aggregates[i].ready(now))
+      continue;
+    if (MQTT.connected())
+      sendAggregate(i);
+    aggregates[i].restart();
+  }
+}
 
-if(!isnan(t))
-  temperature = temperature + TEMPERATURE_SMOOTHING_CONSTANT * (t - temperature);
+static char* appendField(char* p, int32_t value){
+  *p++ = ',';
+  return p + formatDeci(value, p);
+}
 
-if(!isnan(h))
-  humidity    = humidity    + TEMPERATURE_SMOOTHING_CONSTANT * (h - humidity);
+// Publishes "samples,tmin,tmean,tmax,tstd,hmin,hmean,hmax,hstd,heater,
+// humidifier,fan1,fan2": readings in 0.1 units like the other status
+// topics, duty cycles in percent.
+void sendAggregate(uint8_t index){
+  const WindowAggregator& a = aggregates[index];
+  char payload[96];
+  char* p = payload + formatUnsigned(a.samples, payload);
+
+  p = appendField(p, a.temperature.min);
+  p = appendField(p, a.temperature.mean());
+  p = appendField(p, a.temperature.max);
+  p = appendField(p, a.temperature.stddev());
+  p = appendField(p, a.humidity.min);
+  p = appendField(p, a.humidity.mean());
+  p = appendField(p, a.humidity.max);
+  p = appendField(p, a.humidity.stddev());
+  for (uint8_t i = 0; i < AGGREGATOR_ACTUATORS; i++) {
+    *p++ = ',';
+    p += formatUnsigned(a.duty(i), p);
+  }
+
+  MQTT.publish(aggTopic[index], payload, false);
+}
+
+void resetAggregates(){
+  for (uint8_t i = 0; i < AGG_WINDOWS; i++)
+    aggregates[i].restart();
+}
+
+// A barely identified fit can report absurd values, keep them printable.
+static int32_t modelDeci(float value){
+  if (value > 99999)
+    return 999990;
+  if (value < -99999)
+    return -999990;
+  return (int32_t)(value * 10 + (value >= 0 ? 0.5f : -0.5f));
+}
+
+// Publishes the fitted chamber parameters on ESPID/status/model as
+// "tau,gain,ambient,error,updates": time constant in s, heater gain and
+// ambient in 0.1 C, gain uncertainty in percent. Nothing is sent until the
+// temperature moved enough for these to be identified: at a steady
+// setpoint they drift while their uncertainty stays small, see
+// ThermalModel.h. The last identified fit stays retained.
+void sendModel(){
+  const ThermalModel& m = controller.model;
+  if (!MQTT.connected() || !m.identified())
+    return;
+
+  char topic[TELEMETRY_TOPIC_SIZE];
+  char payload[48];
+  float tau = m.timeConstant();
+  float error = 100 * m.gainError();
+  char* p = payload + formatUnsigned(tau < 1e6f ? (uint32_t)tau : 999999, payload);
+
+  p = appendField(p, modelDeci(m.heaterGain()));
+  p = appendField(p, modelDeci(m.ambient()));
+  *p++ = ',';
+  p += formatUnsigned(error < 999 ? (uint32_t)(error + 0.5f) : 999, p);
+  *p++ = ',';
+  p += formatUnsigned(m.updates, p);
+
+  sprintf(topic, "%s/status/model", espID);
+  MQTT.publish(topic, payload, true);
+}
+
+// The controller runs on a copy of the settings. Without a recipe it is
+// systemData as is; with one, the setpoints, the humidifier pulse and the
+// fans follow the recipe phase for the time since the start of the run,
+// and the set/temperature style commands have no effect until the recipe
+// is cleared.
+void applyRecipe(){
+  activeData = systemData;
+  activeFans = RECIPE_FAN1 | RECIPE_FAN2;
+
+  uint8_t lastPhase = recipeTargets.phase;
+  bool wasActive = recipeActive;
+  uint32_t now = timeClient.getEpochTime();
+  recipeActive = now >= MIN_VALID_EPOCH && now >= systemData.startEpochTime
+                 && recipe.targets(now - systemData.startEpochTime, recipeTargets);
+  if(!recipeActive)
+    return;
+
+  activeData.setTemperature = recipeTargets.temperature;
+  activeData.setHumidity = recipeTargets.humidity;
+  activeData.setVpd = 0;    // phases set humidity, a VPD setpoint would override it
+  activeData.humidifierPeriod = recipeTargets.humidifierPeriod;
+  activeData.humidifierActiveTime = recipeTargets.humidifierActiveTime;
+  activeFans = recipeTargets.fans;
+
+  if(!wasActive || recipeTargets.phase != lastPhase){
+    Serial.print("recipe phase ");
+    Serial.println(recipeTargets.phase);
+  }
+}
+
+// Publishes "phase,temperature,humidity,done" on ESPID/status/recipe when
+// the phase changes and on the heartbeat, setpoints in 0.1 units.
+void sendRecipeStatus(bool force){
+  if(!recipeActive)
+    return;
+
+  int32_t value = recipeTargets.phase * 2 + recipeTargets.done;
+  if(!force && !recipeReport.changed(value))
+    return;
+
+  char topic[TELEMETRY_TOPIC_SIZE];
+  char* p = msg + formatUnsigned(recipeTargets.phase, msg);
+  p = appendField(p, recipeTargets.temperature);
+  p = appendField(p, recipeTargets.humidity);
+  *p++ = ',';
+  formatUnsigned(recipeTargets.done, p);
+
+  sprintf(topic, "%s/status/recipe", espID);
+  if(MQTT.publish(topic, msg, true))
+    recipeReport.set(value);
 }
 
 void processActuators(){
@@ -129,45 +641,49 @@ void processActuators(){
   processFan2();
 }
 
+// Without a recent reading the PID would act on a frozen temperature, so
+// the heater stays off and the loop starts over once readings are back.
 void processHeater(){
-  float error = systemData.setTemperature - temperature;
-  if(error > 0)
-    digitalWrite(GPIO_PIN_HEATER, HIGH);
-  else
-    digitalWrite(GPIO_PIN_HEATER, LOW);
+  uint32_t now = millis();
+  if (now - lastReading > SENSOR_MAX_AGE) {
+    controller.resetHeater();
+    heaterOutput.set(false, now);
+    return;
+  }
+  heaterOutput.set(controller.processHeater(now), now);
 }
 
 void processHumidifier(){
-  uint32_t actualEpoch = timeClient.getEpochTime();
+  bool wasPulse = controller.humidifierPulse;
+  uint32_t now = localTime();
+  bool on = controller.processHumidifier(now);
 
-  if((actualEpoch >= humidifierEpoch) && (systemData.humidifierActiveTime != 0) && (systemData.humidifierPeriod != 0)){
+  if(controller.humidifierPulse && !wasPulse)
     Serial.println("periodic humidifier");
-    if(!digitalRead(GPIO_PIN_HUMIDIFIER))
-      digitalWrite(GPIO_PIN_HUMIDIFIER, HIGH);
-    if(actualEpoch > (humidifierEpoch + systemData.humidifierActiveTime)){
-      Serial.println("stopped periodic humidifier");
-      humidifierEpoch = actualEpoch + (systemData.humidifierPeriod * 60);
-      digitalWrite(GPIO_PIN_HUMIDIFIER, LOW);
-    }
-  } else {
-    Serial.println("error humidifier");
-    float error = systemData.setHumidity - humidity;
-    if(error > 0)
-      digitalWrite(GPIO_PIN_HUMIDIFIER, HIGH);
-    else
-      digitalWrite(GPIO_PIN_HUMIDIFIER, LOW);
-  }
+  else if(!controller.humidifierPulse && wasPulse)
+    Serial.println("stopped periodic humidifier");
 
+  humidifierOutput.set(controller.humidifierSchedule.limit(on, now), millis());
 }
 
 void processFan1(){
-  if(!digitalRead(GPIO_PIN_FAN1))
-    digitalWrite(GPIO_PIN_FAN1, HIGH);
+  fan1Output.set(processFan(fan1Schedule, activeFans & RECIPE_FAN1), millis());
 }
 
 void processFan2(){
-  if(!digitalRead(GPIO_PIN_FAN2))
-    digitalWrite(GPIO_PIN_FAN2, HIGH);
+  fan2Output.set(processFan(fan2Schedule, activeFans & RECIPE_FAN2), millis());
+}
+
+// A fan the recipe enables runs all the time, or only during the windows
+// of its schedule if it has any.
+bool processFan(OutputSchedule& schedule, bool enabled){
+  uint32_t now = localTime();
+  bool on = enabled && (schedule.count() == 0 || schedule.active(now));
+  return schedule.limit(on, now);
+}
+
+uint32_t localTime(){
+  return timeClient.getEpochTime() + UTC_OFFSET;
 }
 
 //CONFIGURAÇÃO DA INTERFACE DE REDE
@@ -186,6 +702,8 @@ void reconectar() {
     if (MQTT.connect(espID)) {
       Serial.println("Conectado com Sucesso ao Broker");
 
+        forceReport = true;
+
         setupSubscriptions();
 
     } else {
@@ -196,17 +714,8 @@ void reconectar() {
 }
 
 void setupPin() {
-  pinMode(GPIO_PIN_HEATER, OUTPUT);
-  digitalWrite(GPIO_PIN_HEATER, LOW);
-
-  pinMode(GPIO_PIN_HUMIDIFIER, OUTPUT);
-  digitalWrite(GPIO_PIN_HUMIDIFIER, LOW);
-
-  pinMode(GPIO_PIN_FAN1, OUTPUT);
-  digitalWrite(GPIO_PIN_FAN1, LOW);
-
-  pinMode(GPIO_PIN_FAN2, OUTPUT);
-  digitalWrite(GPIO_PIN_FAN2, LOW);
+  for (uint8_t i = 0; i < RTC_ACTUATORS; i++)
+    actuators[i]->begin(millis());
 }
 
 void setupSubscriptions(){
@@ -218,164 +727,433 @@ void setupSubscriptions(){
 }
 
 void sendStatus(){
-  char topic[20];
-  sprintf(msg, "%.1f", temperature);
-  sprintf(topic, "%s/status/temperature", espID);
-  MQTT.publish(topic, msg, true);
-
-  sprintf(msg, "%.1f", humidity);
-  sprintf(topic, "%s/status/humidity", espID);
-  MQTT.publish(topic, msg, true);
+  bool force = forceReport || (millis() - lastHeartbeat >= 1000UL * HEARTBEAT_INTERVAL);
+  if(force){
+    forceReport = false;
+    lastHeartbeat = millis();
+  }
 
   Serial.print("H: ");
-  Serial.print(humidity);
+  formatDeci(controller.humidity, msg);
+  Serial.print(msg);
   Serial.print(" %\t");
   Serial.print("T: ");
-  Serial.println(temperature);
+  formatDeci(controller.temperature, msg);
+  Serial.println(msg);
 
-  timeClient.update();
-  uint32_t daysElapsed = (timeClient.getEpochTime() - systemData.startEpochTime)/86400;
-  sprintf(msg, "%d", daysElapsed);
-  sprintf(topic, "%s/status/elapsed", espID);
-  MQTT.publish(topic, msg, true);
+  sendRecipeStatus(force);
 
-////////////////////
-  sprintf(msg, "%d", systemData.startEpochTime);
-  sprintf(topic, "%s/status/elapsed2", espID);
-  MQTT.publish(topic, msg, true);
-////////////////////
+#if STATUS_SNAPSHOT
+  sendSnapshot(force);
+  return;
+#endif
 
-  sprintf(msg, "%d", digitalRead(GPIO_PIN_HEATER));
-  sprintf(topic, "%s/status/heater", espID);
-  MQTT.publish(topic, msg, true);
+  int32_t value = controller.temperature;
+  if(force || temperatureReport.changed(value)){
+    formatDeci(value, msg);
+    publishStatus(FIELD_TEMPERATURE, msg, temperatureReport, value);
+  }
 
-  sprintf(msg, "%d", digitalRead(GPIO_PIN_HUMIDIFIER));
-  sprintf(topic, "%s/status/humidifier", espID);
-  MQTT.publish(topic, msg, true);
+  value = controller.humidity;
+  if(force || humidityReport.changed(value)){
+    formatDeci(value, msg);
+    publishStatus(FIELD_HUMIDITY, msg, humidityReport, value);
+  }
 
-  sprintf(msg, "%d", digitalRead(GPIO_PIN_FAN1));
-  sprintf(topic, "%s/status/fan1", espID);
-  MQTT.publish(topic, msg, true);
+  int16_t t = controller.temperature;
+  uint16_t h = controller.humidity;
+  value = dewPoint(t, h);
+  if(force || dewPointReport.changed(value)){
+    formatDeci(value, msg);
+    publishStatus(FIELD_DEWPOINT, msg, dewPointReport, value);
+  }
 
-  sprintf(msg, "%d", digitalRead(GPIO_PIN_FAN2));
-  sprintf(topic, "%s/status/fan2", espID);
-  MQTT.publish(topic, msg, true);
-}
+  value = vapourPressureDeficit(t, h);
+  if(force || vpdReport.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_VPD, msg, vpdReport, value);
+  }
 
-void loadSystemData(){
+  value = absoluteHumidity(t, h);
+  if(force || absHumidityReport.changed(value)){
+    formatDeci(value, msg);
+    publishStatus(FIELD_ABSHUMIDITY, msg, absHumidityReport, value);
+  }
 
-  if(SPIFFS.begin()){
-    Serial.println("SPIFFS Initialize....ok");
-  } else {
-    Serial.println("SPIFFS Initialization...failed");
+  value = (timeClient.getEpochTime() - systemData.startEpochTime)/86400;
+  if(force || elapsedReport.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_ELAPSED, msg, elapsedReport, value);
   }
 
-  File f = SPIFFS.open("systemData.txt", "r");
+////////////////////
+  value = systemData.startEpochTime;
+  if(force || elapsed2Report.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_ELAPSED2, msg, elapsed2Report, value);
+  }
+////////////////////
 
-  if (!f) {
-    Serial.println("file open failed");
-    systemData.state = 0;
-  } else {
-      Serial.println("Reading Data from File:");
-      //Data from file
-      f.read((uint8_t*)&systemData, sizeof(systemData));
+  value = heaterOutput.state();
+  if(force || heaterReport.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_HEATER, msg, heaterReport, value);
+  }
 
-      f.close();  //Close file
-      Serial.println("File Closed");
+  value = humidifierOutput.state();
+  if(force || humidifierReport.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_HUMIDIFIER, msg, humidifierReport, value);
   }
-}
 
-void saveSystemData(){
+  value = fan1Output.state();
+  if(force || fan1Report.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_FAN1, msg, fan1Report, value);
+  }
 
-  if(SPIFFS.begin()){
-    Serial.println("SPIFFS Initialize....ok");
-  } else {
-    Serial.println("SPIFFS Initialization...failed");
+  value = fan2Output.state();
+  if(force || fan2Report.changed(value)){
+    formatInt(value, msg);
+    publishStatus(FIELD_FAN2, msg, fan2Report, value);
   }
+}
 
-  File f = SPIFFS.open("systemData.txt", "w");
+bool publishStatus(uint8_t field, const char* payload, ReportFilter& report, int32_t value){
+  if(!MQTT.publish(telemetry.topic(field), payload, true))
+    return false;
 
-  if (!f) {
-    Serial.println("file open failed");
+  report.set(value);
+  return true;
+}
 
-  } else {
-      Serial.println("Writing Data from File:");
-      //Data from file
-      f.write((uint8_t*)&systemData, sizeof(systemData));
+void sendSnapshot(bool force){
+  StatusSnapshot s;
+  uint8_t buff[STATUS_SNAPSHOT_SIZE];
+
+  s.epoch = timeClient.getEpochTime();
+  s.startEpochTime = systemData.startEpochTime;
+  s.daysElapsed = (s.epoch - systemData.startEpochTime)/86400;
+  s.temperature = controller.temperature;
+  s.humidity = controller.humidity;
+  s.dewPoint = dewPoint(s.temperature, s.humidity);
+  s.vpd = vapourPressureDeficit(s.temperature, s.humidity);
+  s.absHumidity = absoluteHumidity(s.temperature, s.humidity);
+  s.flags = statusFlags();
+  bool heater = s.flags & STATUS_FLAG_HEATER;
+  bool humidifier = s.flags & STATUS_FLAG_HUMIDIFIER;
+  bool fan1 = s.flags & STATUS_FLAG_FAN1;
+  bool fan2 = s.flags & STATUS_FLAG_FAN2;
+
+  if(!force
+     && !temperatureReport.changed(s.temperature)
+     && !humidityReport.changed(s.humidity)
+     && !dewPointReport.changed(s.dewPoint)
+     && !vpdReport.changed(s.vpd)
+     && !absHumidityReport.changed(s.absHumidity)
+     && !elapsedReport.changed(s.daysElapsed)
+     && !elapsed2Report.changed(s.startEpochTime)
+     && !heaterReport.changed(heater)
+     && !humidifierReport.changed(humidifier)
+     && !fan1Report.changed(fan1)
+     && !fan2Report.changed(fan2))
+    return;
+
+  if(!MQTT.publish(telemetry.topic(FIELD_SNAPSHOT), buff, encodeStatusSnapshot(s, buff), true))
+    return;
+
+  temperatureReport.set(s.temperature);
+  humidityReport.set(s.humidity);
+  dewPointReport.set(s.dewPoint);
+  vpdReport.set(s.vpd);
+  absHumidityReport.set(s.absHumidity);
+  elapsedReport.set(s.daysElapsed);
+  elapsed2Report.set(s.startEpochTime);
+  heaterReport.set(heater);
+  humidifierReport.set(humidifier);
+  fan1Report.set(fan1);
+  fan2Report.set(fan2);
+}
 
-      f.close();  //Close file
-      Serial.println("File Closed");
-  }
+uint8_t statusFlags(){
+  uint8_t flags = 0;
+  if(heaterOutput.state())
+    flags |= STATUS_FLAG_HEATER;
+  if(humidifierOutput.state())
+    flags |= STATUS_FLAG_HUMIDIFIER;
+  if(fan1Output.state())
+    flags |= STATUS_FLAG_FAN1;
+  if(fan2Output.state())
+    flags |= STATUS_FLAG_FAN2;
+  if(systemData.state == 1)
+    flags |= STATUS_FLAG_RUNNING;
+  return flags;
 }
 
-void callback(char* topic, byte* payload, unsigned int length) {
+// Samples without a valid NTP time cannot be placed by the server and are
+// not stored.
+void logSample(){
+  if(millis() - lastOfflineSample < 1000UL * OFFLINE_LOG_INTERVAL)
+    return;
+  lastOfflineSample = millis();
+
+  LogSample sample;
+  sample.epoch = timeClient.getEpochTime();
+  if(sample.epoch < systemData.startEpochTime)
+    return;
+  sample.temperature = controller.temperature;
+  sample.humidity = controller.humidity;
+  sample.flags = statusFlags();
+  if(!sampleLog.append(sample))
+    Serial.println("sample log write failed");
+}
 
-  String msg_buff;
-  for (int i = 0; i < length; i++)
-    msg_buff += (char)payload[i];
+void setupCommands(){
+  commands.begin(espID);
+  commands.add("state",                 cmdState);
+  commands.add("temperature",           cmdTemperature);
+  commands.add("humidity",              cmdHumidity);
+  commands.add("vpd",                   cmdVpd);
+  commands.add("humidifier/period",     cmdHumidifierPeriod);
+  commands.add("humidifier/activetime", cmdHumidifierActiveTime);
+  commands.add("config",                cmdConfig);
+  commands.add("heater/kp",             cmdHeaterKp);
+  commands.add("heater/ki",             cmdHeaterKi);
+  commands.add("heater/kd",             cmdHeaterKd);
+  commands.add("heater/window",         cmdHeaterWindow);
+  commands.add("recipe",                cmdRecipe);
+  commands.add("recipe/phase",          cmdRecipePhase);
+  commands.add("humidifier/schedule",   cmdHumidifierSchedule);
+  commands.add("humidifier/maxduty",    cmdHumidifierMaxDuty);
+  commands.add("fan1/schedule",         cmdFan1Schedule);
+  commands.add("fan1/maxduty",          cmdFan1MaxDuty);
+  commands.add("fan2/schedule",         cmdFan2Schedule);
+  commands.add("fan2/maxduty",          cmdFan2MaxDuty);
+}
 
+// payload points into the PubSubClient buffer and is not NUL terminated.
+void callback(char* topic, byte* payload, unsigned int length) {
   Serial.println("Received:");
   Serial.print("topic: ");
   Serial.println(topic);
   Serial.print("payload: ");
-  Serial.println(msg_buff);
+  Serial.write(payload, length);
+  Serial.println();
 
-  char topic_buff[50];
+  if (!commands.dispatch(topic, payload, length))
+    Serial.println("unknown command");
+}
 
-  sprintf(topic_buff, "%s/set/state", espID);
-  if (strcmp(topic, topic_buff) == 0)
+void cmdState(const uint8_t* payload, uint16_t length){
+  if (length == 1 && payload[0] == '1')
   {
-    if (msg_buff == String('1'))
+    if(systemData.state != 1)
     {
-      if(systemData.state != 1)
-      {
-        systemData.state = 1;
-        timeClient.update();
-        systemData.startEpochTime = timeClient.getEpochTime();
-        saveSystemData();
-      }
+      systemData.state = 1;
+      timeClient.update();
+      systemData.startEpochTime = timeClient.getEpochTime();
+      settings.flush();
+      controller.resetHeater();
     }
-    else
+  }
+  else
+  {
+    if(systemData.state != 0)
     {
-      if(systemData.state != 0)
-      {
-        systemData.state = 0;
-        saveSystemData();
-        digitalWrite(GPIO_PIN_HEATER, LOW);
-        digitalWrite(GPIO_PIN_HUMIDIFIER, LOW);
-        digitalWrite(GPIO_PIN_FAN1, LOW);
-        digitalWrite(GPIO_PIN_FAN2, LOW);
-        sendStatus();
-      }
+      systemData.state = 0;
+      settings.flush();
+      stopOutputs();
     }
   }
+}
 
-  sprintf(topic_buff, "%s/set/temperature", espID);
-  if (strcmp(topic, topic_buff) == 0)
-  {
-      systemData.setTemperature = msg_buff.toFloat();
-      saveSystemData();
+void stopOutputs(){
+  resetAggregates();
+  for (uint8_t i = 0; i < RTC_ACTUATORS; i++)
+    actuators[i]->force(false, millis());
+  sendStatus();
+}
+
+// Malformed or out of range numbers are ignored instead of being stored.
+void cmdTemperature(const uint8_t* payload, uint16_t length){
+  int32_t value;
+  if (!parseDeci(payload, length, value) || value < 0 || value > CONFIG_MAX_TEMPERATURE)
+    return;
+  systemData.setTemperature = value;
+  settings.save(millis());
+}
+
+void cmdHumidity(const uint8_t* payload, uint16_t length){
+  int32_t value;
+  if (!parseDeci(payload, length, value) || value < 0 || value > CONFIG_MAX_HUMIDITY)
+    return;
+  systemData.setHumidity = value;
+  settings.save(millis());
+}
+
+void cmdVpd(const uint8_t* payload, uint16_t length){
+  if (!parseVpd(payload, length, systemData.setVpd))
+    return;
+  settings.save(millis());
+}
+
+// A period shorter than the active time, or the other way around, is
+// refused like it is in ESPID/set/config.
+void cmdHumidifierPeriod(const uint8_t* payload, uint16_t length){
+  uint32_t value;
+  if (!parsePeriod(payload, length, value) || !validSchedule(value, systemData.humidifierActiveTime))
+    return;
+  systemData.humidifierPeriod = value;
+  settings.save(millis());
+}
+
+void cmdHumidifierActiveTime(const uint8_t* payload, uint16_t length){
+  uint32_t value;
+  if (!parseActiveTime(payload, length, value) || !validSchedule(systemData.humidifierPeriod, value))
+    return;
+  systemData.humidifierActiveTime = value;
+  settings.save(millis());
+}
+
+void cmdHeaterKp(const uint8_t* payload, uint16_t length){
+  if (parseGain(payload, length, systemData.heaterKp))
+    settings.save(millis());
+}
+
+void cmdHeaterKi(const uint8_t* payload, uint16_t length){
+  if (parseGain(payload, length, systemData.heaterKi))
+    settings.save(millis());
+}
+
+void cmdHeaterKd(const uint8_t* payload, uint16_t length){
+  if (parseGain(payload, length, systemData.heaterKd))
+    settings.save(millis());
+}
+
+void cmdHeaterWindow(const uint8_t* payload, uint16_t length){
+  int32_t value;
+  if (!parseInt(payload, length, value) || value < CONFIG_MIN_WINDOW || value > CONFIG_MAX_WINDOW)
+    return;
+  systemData.heaterWindow = value;
+  settings.save(millis());
+}
+
+void cmdRecipePhase(const uint8_t* payload, uint16_t length){
+  uint8_t index;
+  RecipePhase phase = {};
+  if (!parseRecipePhase(payload, length, index, phase)) {
+    Serial.println("invalid recipe phase");
+    return;
   }
+  recipeDraft.phases[index] = phase;
+  recipeDraftPhases |= 1 << index;
+}
 
-  sprintf(topic_buff, "%s/set/humidity", espID);
-  if (strcmp(topic, topic_buff) == 0)
-  {
-      systemData.setHumidity = msg_buff.toFloat();
-      saveSystemData();
+// The payload is the number of phases: the recipe made of the phases
+// received so far replaces the current one and is stored, 0 clears it.
+// Phases that were not received make the command fail. A retained command
+// that brings back the stored recipe does not write flash again.
+void cmdRecipe(const uint8_t* payload, uint16_t length){
+  int32_t count;
+  if (!parseInt(payload, length, count) || count < 0 || count > RECIPE_MAX_PHASES)
+    return;
+
+  uint8_t needed = (1 << count) - 1;
+  if ((recipeDraftPhases & needed) != needed) {
+    Serial.println("recipe incomplete");
+    return;
   }
 
-  sprintf(topic_buff, "%s/set/humidifier/period", espID);
-  if (strcmp(topic, topic_buff) == 0)
-  {
-      systemData.humidifierPeriod = msg_buff.toInt();
-      saveSystemData();
+  Recipe next;
+  next.count = count;
+  for (uint8_t i = 0; i < count; i++)
+    next.phases[i] = recipeDraft.phases[i];
+  recipeDraftPhases = 0;
+  // Compared in the stored form: the structs have padding and unused phases.
+  uint8_t a[RECIPE_MAX_SIZE], b[RECIPE_MAX_SIZE];
+  uint16_t size = encodeRecipe(next, a);
+  if (size == encodeRecipe(recipe, b) && memcmp(a, b, size) == 0)
+    return;
+
+  recipe = next;
+  recipeReport.reset();
+  if (!saveRecipe(recipe))
+    Serial.println("recipe not saved");
+}
+
+void cmdSchedule(OutputSchedule& schedule, const uint8_t* payload, uint16_t length){
+  if (!parseSchedule(payload, length, schedule)) {
+    Serial.println("invalid schedule");
+    return;
   }
+  saveOutputSchedules();
+}
 
-  sprintf(topic_buff, "%s/set/humidifier/activetime", espID);
-  if (strcmp(topic, topic_buff) == 0)
-  {
-      systemData.humidifierActiveTime = msg_buff.toInt();
-      saveSystemData();
+void cmdMaxDuty(OutputSchedule& schedule, const uint8_t* payload, uint16_t length){
+  int32_t value;
+  if (!parseInt(payload, length, value) || value < 0 || value > 100)
+    return;
+  schedule.setMaxDuty(value);
+  saveOutputSchedules();
+}
+
+void cmdHumidifierSchedule(const uint8_t* payload, uint16_t length){
+  cmdSchedule(controller.humidifierSchedule, payload, length);
+}
+
+void cmdHumidifierMaxDuty(const uint8_t* payload, uint16_t length){
+  cmdMaxDuty(controller.humidifierSchedule, payload, length);
+}
+
+void cmdFan1Schedule(const uint8_t* payload, uint16_t length){
+  cmdSchedule(fan1Schedule, payload, length);
+}
+
+void cmdFan1MaxDuty(const uint8_t* payload, uint16_t length){
+  cmdMaxDuty(fan1Schedule, payload, length);
+}
+
+void cmdFan2Schedule(const uint8_t* payload, uint16_t length){
+  cmdSchedule(fan2Schedule, payload, length);
+}
+
+void cmdFan2MaxDuty(const uint8_t* payload, uint16_t length){
+  cmdMaxDuty(fan2Schedule, payload, length);
+}
+
+// Schedules change rarely, they are written at once. Retained commands
+// replayed after a reconnect bring back what is already stored and do not
+// write flash again, see saveSchedules().
+void saveOutputSchedules(){
+  if (!saveSchedules(schedules, SCHEDULES))
+    Serial.println("schedules not saved");
+}
+
+// All fields are validated on a copy and applied together, followed by a
+// single flash write, so the controller never runs on half applied settings.
+// Starting without a start key takes the current time, like set/state.
+void cmdConfig(const uint8_t* payload, uint16_t length){
+  SystemData next = systemData;
+  uint8_t fields;
+  if (!parseSystemConfig(payload, length, next, fields)) {
+    Serial.println("invalid config");
+    return;
   }
 
+  bool starting = next.state == 1 && systemData.state != 1;
+  bool stopping = next.state != 1 && systemData.state == 1;
+  if (starting && !(fields & CONFIG_HAS_START)) {
+    timeClient.update();
+    next.startEpochTime = timeClient.getEpochTime();
+  }
+
+  systemData = next;
+  if (starting)
+    controller.resetHeater();
+  if (starting || stopping)
+    settings.flush();
+  else
+    settings.save(millis());
+  if (stopping)
+    stopOutputs();
 }
@@ -0,0 +1,199 @@
+/*
+ command_bench.cpp - Cost of handling one inbound command on the host.
+
+ Compares the callback() the firmware used before with CommandDispatcher.
+ The old path copied the payload into an Arduino String one character at a
+ time, which reallocates on every byte, then rebuilt "%s/set/..." with
+ sprintf() and compared it for each of the five commands, even after one
+ had matched, and parsed values with toFloat()/toInt(). LegacyString below
+ grows the same way String::concat(char) does. The new path hashes the
+ topic suffix once and parses the payload in place.
+
+ Both paths run over the same mix of the five commands, with a handler
+ that stores the parsed value where the firmware would.
+
+ Build and run with PlatformIO:
+   pio run -e command_bench
+   .pio/build/command_bench/program
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include <CommandDispatcher.h>
+
+#define MESSAGES    5
+#define ITERATIONS  1000000
+
+static const char* espID = "A1B2C3";
+
+static const char* topics[MESSAGES] = {
+  "A1B2C3/set/state",
+  "A1B2C3/set/temperature",
+  "A1B2C3/set/humidity",
+  "A1B2C3/set/humidifier/period",
+  "A1B2C3/set/humidifier/activetime"
+};
+
+static const char* payloads[MESSAGES] = { "1", "25.5", "85", "120", "30" };
+
+struct Settings {
+  uint8_t   state;
+  float     setTemperature;
+  float     setHumidity;
+  uint32_t  humidifierPeriod;
+  uint32_t  humidifierActiveTime;
+};
+
+static volatile Settings settings;
+static uint32_t allocations;
+
+// Arduino String growth: reserve() reallocs to exactly the new length.
+class LegacyString {
+  public:
+    LegacyString() : _buffer(NULL), _length(0) {}
+    ~LegacyString() { free(_buffer); }
+
+    void operator+=(char c) {
+      _buffer = (char*)realloc(_buffer, _length + 2);
+      allocations++;
+      _buffer[_length++] = c;
+      _buffer[_length] = '\0';
+    }
+
+    bool  operator==(const char* s) const { return strcmp(_buffer ? _buffer : "", s) == 0; }
+    float toFloat() const { return _buffer ? atof(_buffer) : 0; }
+    long  toInt() const { return _buffer ? atol(_buffer) : 0; }
+
+  private:
+    char*     _buffer;
+    uint32_t  _length;
+};
+
+__attribute__((noinline)) static void legacyCallback(const char* topic, const uint8_t* payload, unsigned int length) {
+  LegacyString msg_buff;
+  for (unsigned int i = 0; i < length; i++)
+    msg_buff += (char)payload[i];
+
+  char topic_buff[50];
+
+  sprintf(topic_buff, "%s/set/state", espID);
+  if (strcmp(topic, topic_buff) == 0)
+    settings.state = msg_buff == "1";
+
+  sprintf(topic_buff, "%s/set/temperature", espID);
+  if (strcmp(topic, topic_buff) == 0)
+    settings.setTemperature = msg_buff.toFloat();
+
+  sprintf(topic_buff, "%s/set/humidity", espID);
+  if (strcmp(topic, topic_buff) == 0)
+    settings.setHumidity = msg_buff.toFloat();
+
+  sprintf(topic_buff, "%s/set/humidifier/period", espID);
+  if (strcmp(topic, topic_buff) == 0)
+    settings.humidifierPeriod = msg_buff.toInt();
+
+  sprintf(topic_buff, "%s/set/humidifier/activetime", espID);
+  if (strcmp(topic, topic_buff) == 0)
+    settings.humidifierActiveTime = msg_buff.toInt();
+}
+
+static CommandDispatcher commands;
+
+static void cmdState(const uint8_t* payload, uint16_t length) {
+  settings.state = length == 1 && payload[0] == '1';
+}
+
+static void cmdTemperature(const uint8_t* payload, uint16_t length) {
+  int32_t value;
+  if (parseDeci(payload, length, value))
+    settings.setTemperature = value / 10.0f;
+}
+
+static void cmdHumidity(const uint8_t* payload, uint16_t length) {
+  int32_t value;
+  if (parseDeci(payload, length, value))
+    settings.setHumidity = value / 10.0f;
+}
+
+static void cmdHumidifierPeriod(const uint8_t* payload, uint16_t length) {
+  int32_t value;
+  if (parseInt(payload, length, value) && value >= 0)
+    settings.humidifierPeriod = value;
+}
+
+static void cmdHumidifierActiveTime(const uint8_t* payload, uint16_t length) {
+  int32_t value;
+  if (parseInt(payload, length, value) && value >= 0)
+    settings.humidifierActiveTime = value;
+}
+
+__attribute__((noinline)) static void dispatcherCallback(const char* topic, const uint8_t* payload, unsigned int length) {
+  commands.dispatch(topic, payload, length);
+}
+
+static uint64_t nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cycles() {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void run(const char* name, void (*callback)(const char*, const uint8_t*, unsigned int)) {
+  uint16_t lengths[MESSAGES];
+  for (uint8_t i = 0; i < MESSAGES; i++)
+    lengths[i] = strlen(payloads[i]);
+
+  for (uint32_t i = 0; i < 1000; i++)   // warm up
+    callback(topics[i % MESSAGES], (const uint8_t*)payloads[i % MESSAGES], lengths[i % MESSAGES]);
+
+  allocations = 0;
+  uint64_t t0 = nanos();
+  uint64_t c0 = cycles();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    uint8_t m = i % MESSAGES;
+    callback(topics[m], (const uint8_t*)payloads[m], lengths[m]);
+  }
+  uint64_t c1 = cycles();
+  uint64_t t1 = nanos();
+
+  printf("%-10s %8.1f ns/message", name, (t1 - t0) / (double)ITERATIONS);
+#ifdef HAVE_TSC
+  printf("  %8.1f cycles/message", (c1 - c0) / (double)ITERATIONS);
+#endif
+  printf("  %5.2f allocations/message\n", allocations / (double)ITERATIONS);
+}
+
+int main() {
+  commands.begin(espID);
+  commands.add("state",                 cmdState);
+  commands.add("temperature",           cmdTemperature);
+  commands.add("humidity",              cmdHumidity);
+  commands.add("humidifier/period",     cmdHumidifierPeriod);
+  commands.add("humidifier/activetime", cmdHumidifierActiveTime);
+
+  run("legacy", legacyCallback);
+  Settings legacy;
+  memcpy(&legacy, (const void*)&settings, sizeof(legacy));
+  memset((void*)&settings, 0, sizeof(settings));
+
+  run("dispatcher", dispatcherCallback);
+  if (memcmp(&legacy, (const void*)&settings, sizeof(legacy)) != 0)
+    printf("warning: both paths did not end with the same settings\n");
+  return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ dht_replay.cpp - Feeds synthetic DHT pulse trains to DhtDecoder on the host.
+
+ Every frame is built as the edge times a DHT22 would produce: the release
+ of the start signal, the 80 us answer, 40 bits and the final falling edge.
+ The times are taken as the low 16 bits of a cycle counter or of micros()
+ starting just below the wrap, so every frame crosses it, and go through
+ the same dhtCyclesToMicros()/decodeDhtPulses() calls as the driver.
+
+ Cases:
+  - clean frames and frames with edge jitter, each edge delayed by up to the
+    given latency as by a late interrupt, against the DHT_* tolerances
+  - trains cut after every possible edge
+  - frames with a corrupt pulse, a lost edge, a glitch edge or a wrong
+    checksum
+
+ A corrupt frame may be rejected with any error, but it must never decode
+ to different bytes. Exits with 1 on any unexpected result.
+
+ Build and run with PlatformIO:
+   pio run -e dht_replay
+   .pio/build/dht_replay/program
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <DhtDecoder.h>
+
+#define FRAMES          10000
+#define FRAME_EDGES     84      // release, 3 answer edges, 80 bit edges
+#define WRAP_MARGIN     2000    // first edge this many ticks before the wrap
+
+struct Frame {
+  uint8_t   data[5];
+  uint32_t  times[DHT_MAX_EDGES];   // in us from the release
+  uint8_t   count;
+};
+
+struct Tally {
+  uint32_t  results[4];             // indexed by DHT_OK, DHT_ERROR_*
+  uint32_t  wrong;                  // DHT_OK with other bytes
+};
+
+static uint32_t failures = 0;
+
+static uint32_t jitter(uint32_t max) {
+  return max ? rand() % (max + 1) : 0;
+}
+
+// Edge times of a transfer of data, with typical pulse widths and every
+// edge delayed by up to latency us.
+static void buildFrame(Frame& f, const uint8_t data[5], uint32_t latency) {
+  memcpy(f.data, data, 5);
+  uint32_t t = 0;
+  f.count = 0;
+  f.times[f.count++] = 0;         // release
+  t += 30;
+  f.times[f.count++] = t;         // the sensor pulls the line low
+  t += 80;
+  f.times[f.count++] = t;
+  t += 80;
+  f.times[f.count++] = t;         // bit 0 low
+  for (uint8_t i = 0; i < 40; i++) {
+    bool one = data[i / 8] & (0x80 >> (i % 8));
+    t += 50;
+    f.times[f.count++] = t;
+    t += one ? 70 : 27;
+    f.times[f.count++] = t;
+  }
+  for (uint8_t i = 1; i < f.count; i++)
+    f.times[i] += jitter(latency);
+}
+
+static void randomData(uint8_t data[5]) {
+  for (uint8_t i = 0; i < 4; i++)
+    data[i] = rand();
+  data[4] = data[0] + data[1] + data[2] + data[3];
+}
+
+// Replays the edge times as the low 16 bits of a counter running at
+// ticksPerMicro, starting WRAP_MARGIN ticks before it wraps.
+static uint8_t replay(const Frame& f, uint8_t ticksPerMicro, uint8_t data[5]) {
+  uint16_t edges[DHT_MAX_EDGES];
+  uint16_t start = 65536 - WRAP_MARGIN;
+  for (uint8_t i = 0; i < f.count; i++)
+    edges[i] = start + f.times[i] * ticksPerMicro;
+  if (ticksPerMicro > 1)
+    dhtCyclesToMicros(edges, f.count, ticksPerMicro);
+  return decodeDhtPulses(edges, f.count, data);
+}
+
+static void count(Tally& tally, const Frame& f, uint8_t result, const uint8_t data[5]) {
+  tally.results[result]++;
+  if (result == DHT_OK && memcmp(data, f.data, 5) != 0)
+    tally.wrong++;
+}
+
+static void print(const char* name, const Tally& t, bool pass) {
+  printf("%-22s %6u %8u %6u %9u %6u  %s\n", name,
+         t.results[DHT_OK], t.results[DHT_ERROR_TIMEOUT], t.results[DHT_ERROR_PULSE],
+         t.results[DHT_ERROR_CHECKSUM], t.wrong, pass ? "" : "FAIL");
+  if (!pass)
+    failures++;
+}
+
+// Latencies up to the margin of the tolerances must always decode; above it
+// frames may be lost but never misread.
+static void testJitter(uint8_t ticksPerMicro) {
+  static const uint32_t latencies[] = { 0, 5, 10, 15, 20, 30 };
+  for (uint8_t l = 0; l < sizeof(latencies) / sizeof(latencies[0]); l++) {
+    Tally tally = {};
+    for (uint32_t n = 0; n < FRAMES; n++) {
+      uint8_t bytes[5], data[5];
+      Frame f;
+      randomData(bytes);
+      buildFrame(f, bytes, latencies[l]);
+      count(tally, f, replay(f, ticksPerMicro, data), data);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "jitter %2u us @%3u MHz", latencies[l], ticksPerMicro);
+    bool pass = tally.wrong == 0 && (latencies[l] > 15 || tally.results[DHT_OK] == FRAMES);
+    print(name, tally, pass);
+  }
+}
+
+static void testTruncated(uint8_t ticksPerMicro) {
+  Tally tally = {};
+  uint8_t bytes[5], data[5];
+  randomData(bytes);
+  for (uint8_t cut = 0; cut < FRAME_EDGES; cut++) {
+    Frame f;
+    buildFrame(f, bytes, 0);
+    f.count = cut;
+    count(tally, f, replay(f, ticksPerMicro, data), data);
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "truncated @%3u MHz", ticksPerMicro);
+  print(name, tally, tally.results[DHT_OK] == 0 && tally.results[DHT_ERROR_TIMEOUT] == FRAME_EDGES);
+}
+
+// One edge of the data part moved by delta us, the neighbouring pulses
+// stretched and shrunk.
+static void moveEdge(Frame& f, uint8_t edge, int32_t delta) {
+  f.times[edge] += delta;
+}
+
+static void removeEdge(Frame& f, uint8_t edge) {
+  memmove(f.times + edge, f.times + edge + 1, (f.count - edge - 1) * sizeof(f.times[0]));
+  f.count--;
+}
+
+// Two edges 2 us apart in the middle of a pulse, as a spike on the line. In
+// the high pulse of the last bit it can leave a valid frame.
+static void insertGlitch(Frame& f, uint8_t edge) {
+  if (f.count + 2 > DHT_MAX_EDGES)
+    return;
+  uint32_t at = (f.times[edge - 1] + f.times[edge]) / 2;
+  memmove(f.times + edge + 2, f.times + edge, (f.count - edge) * sizeof(f.times[0]));
+  f.times[edge] = at;
+  f.times[edge + 1] = at + 2;
+  f.count += 2;
+}
+
+static void testCorrupt(uint8_t ticksPerMicro) {
+  Tally moved = {}, lost = {}, glitch = {}, checksum = {};
+  for (uint32_t n = 0; n < FRAMES; n++) {
+    uint8_t bytes[5], data[5];
+    Frame f;
+    randomData(bytes);
+    uint8_t edge = 4 + rand() % 80;
+
+    buildFrame(f, bytes, 0);
+    moveEdge(f, edge, rand() % 2 ? 60 : -40);
+    count(moved, f, replay(f, ticksPerMicro, data), data);
+
+    buildFrame(f, bytes, 0);
+    removeEdge(f, edge);
+    count(lost, f, replay(f, ticksPerMicro, data), data);
+
+    buildFrame(f, bytes, 0);
+    insertGlitch(f, edge);
+    count(glitch, f, replay(f, ticksPerMicro, data), data);
+
+    bytes[4] ^= 1 << (rand() % 8);
+    buildFrame(f, bytes, 0);
+    count(checksum, f, replay(f, ticksPerMicro, data), data);
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "moved edge @%3u MHz", ticksPerMicro);
+  print(name, moved, moved.wrong == 0);
+  snprintf(name, sizeof(name), "lost edge @%3u MHz", ticksPerMicro);
+  print(name, lost, lost.wrong == 0);
+  snprintf(name, sizeof(name), "glitch @%3u MHz", ticksPerMicro);
+  print(name, glitch, glitch.wrong == 0);
+  snprintf(name, sizeof(name), "bad checksum @%3u MHz", ticksPerMicro);
+  print(name, checksum, checksum.results[DHT_ERROR_CHECKSUM] == FRAMES);
+}
+
+int main() {
+  // 1 stands for micros(), 80 and 160 for the ESP8266 cycle counter.
+  static const uint8_t clocks[] = { 1, 80, 160 };
+  srand(1);
+  printf("%-22s %6s %8s %6s %9s %6s\n", "case", "ok", "timeout", "pulse", "checksum", "wrong");
+  for (uint8_t c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++) {
+    testJitter(clocks[c]);
+    testTruncated(clocks[c]);
+    testCorrupt(clocks[c]);
+  }
+  if (failures)
+    printf("%u cases failed\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,653 @@
+/*
+ fleet_sim.cpp - Runs many virtual Fungnator nodes against one MQTT broker.
+
+ Every node owns its own TCP connection and PubSubClient instance, subscribes
+ to ESPID/set/# and publishes the same retained ESPID/status/... topics as
+ sendStatus() every report interval. A separate controller client plays the
+ role of the server: it sends ESPID/set/temperature commands to random nodes
+ and optionally subscribes to +/status/# to measure the broker fan-out.
+ With --snapshot the nodes publish the single binary ESPID/status/snapshot
+ record instead (STATUS_SNAPSHOT=1), which the controller decodes. With
+ --on-change they only publish fields that moved beyond the firmware
+ deadbands, plus everything on the heartbeat interval.
+
+ Reported every few seconds:
+  - node publishes per second and status messages delivered to the controller
+  - end-to-end command latency (controller publish to node callback)
+  - broker CPU and memory, read from /proc
+  - connection losses, reconnects and failed connection attempts, including
+    the recovery time of a forced reconnect storm (--storm-at)
+
+ Build and run with PlatformIO against a local mosquitto:
+   pio run -e fleet_sim
+   .pio/build/fleet_sim/program --nodes 1000 --duration 120 --cmd-rate 20 --subscribe
+*/
+
+#include <dirent.h>
+#include <getopt.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <Psychrometrics.h>
+#include <PubSubClient.h>
+#include <StatusSnapshot.h>
+#include <ReportFilter.h>
+#include <TelemetryEncoder.h>
+#include "host/PosixClient.h"
+
+#define FLEET_ID_BASE     0xF00000
+#define NETWORK_INTERVAL  5000000ULL   // in us, firmware reconnection period
+
+// Same values as src/main.cpp.
+#define TEMPERATURE_DEADBAND  2
+#define HUMIDITY_DEADBAND     10
+#define DEWPOINT_DEADBAND     2
+#define VPD_DEADBAND          20
+#define ABSHUMIDITY_DEADBAND  2
+#define HEARTBEAT_INTERVAL    300ULL        // in s
+
+// The text status fields, FIELD_SNAPSHOT and FIELD_BACKFILL are not among
+// them.
+static const uint8_t textFields[] = {
+  FIELD_TEMPERATURE, FIELD_HUMIDITY, FIELD_ELAPSED, FIELD_ELAPSED2,
+  FIELD_HEATER, FIELD_HUMIDIFIER, FIELD_FAN1, FIELD_FAN2,
+  FIELD_DEWPOINT, FIELD_VPD, FIELD_ABSHUMIDITY
+};
+#define TEXT_FIELDS (sizeof(textFields) / sizeof(textFields[0]))
+
+struct Options {
+  const char* host;
+  uint16_t    port;
+  uint32_t    nodes;
+  uint32_t    duration;       // in s
+  uint32_t    interval;       // node report interval, in s
+  double      cmdRate;        // commands per second over the whole fleet
+  bool        subscribe;
+  bool        snapshot;
+  bool        onChange;
+  int32_t     stormAt;        // in s, -1 disables
+  uint32_t    ramp;           // node connections per second at start, 0 = all at once
+  uint32_t    report;         // in s
+  int         brokerPid;
+};
+
+struct Node {
+  char          id[8];
+  PosixClient   net;
+  PubSubClient  mqtt;
+  TelemetryEncoder telemetry;
+  uint64_t      nextPublish;
+  uint64_t      nextConnect;
+  uint64_t      commandSent;  // 0 when no command is outstanding
+  bool          online;
+
+  // Simulated chamber, values in the units of the snapshot, indexed by
+  // field.
+  int32_t       values[FIELD_COUNT];
+  ReportFilter  reports[FIELD_COUNT];
+  uint64_t      lastHeartbeat;
+  bool          forceReport;
+
+  Node() : mqtt(net) {
+    reports[FIELD_TEMPERATURE].setDeadband(TEMPERATURE_DEADBAND);
+    reports[FIELD_HUMIDITY].setDeadband(HUMIDITY_DEADBAND);
+    reports[FIELD_DEWPOINT].setDeadband(DEWPOINT_DEADBAND);
+    reports[FIELD_VPD].setDeadband(VPD_DEADBAND);
+    reports[FIELD_ABSHUMIDITY].setDeadband(ABSHUMIDITY_DEADBAND);
+  }
+};
+
+struct Counters {
+  uint64_t  publishes;
+  uint64_t  publishBytes;
+  uint64_t  publishFailures;
+  uint64_t  delivered;
+  uint64_t  decodeErrors;
+  uint64_t  commands;
+  uint64_t  commandsLost;
+  uint64_t  connects;
+  uint64_t  connectFailures;
+  uint64_t  losses;
+  uint64_t  connectTime;      // accumulated, in us
+  uint64_t  maxConnectTime;   // in us
+};
+
+static Options              opt;
+static std::vector<Node*>   nodes;
+static Counters             total, window;
+static std::vector<uint32_t> latencies, windowLatencies;
+static uint32_t             online = 0;
+
+static uint64_t now64() {
+  static uint32_t last = 0;
+  static uint64_t high = 0;
+  uint32_t t = micros();
+  if (t < last)
+    high += 1ULL << 32;
+  last = t;
+  return high | t;
+}
+
+static void count(uint64_t Counters::*field, uint64_t n = 1) {
+  total.*field += n;
+  window.*field += n;
+}
+
+static Node* findNode(const char* topic) {
+  char* end;
+  unsigned long id = strtoul(topic, &end, 16);
+  if (*end != '/' || id < FLEET_ID_BASE || id - FLEET_ID_BASE >= nodes.size())
+    return NULL;
+  return nodes[id - FLEET_ID_BASE];
+}
+
+void nodeCallback(char* topic, uint8_t*, unsigned int) {
+  Node* node = findNode(topic);
+  if (!node || !node->commandSent)
+    return;
+
+  uint32_t latency = now64() - node->commandSent;
+  latencies.push_back(latency);
+  windowLatencies.push_back(latency);
+  node->commandSent = 0;
+}
+
+void controllerCallback(char* topic, uint8_t* payload, unsigned int length) {
+  count(&Counters::delivered);
+
+  const char* name = strstr(topic, "/status/");
+  StatusSnapshot s;
+  if (name && strcmp(name, "/status/snapshot") == 0 && !decodeStatusSnapshot(payload, length, s))
+    count(&Counters::decodeErrors);
+}
+
+static bool publish(Node* node, uint8_t field, const uint8_t* payload, unsigned int length) {
+  const char* topic = node->telemetry.topic(field);
+  if (!node->mqtt.publish(topic, payload, length, true)) {
+    count(&Counters::publishFailures);
+    return false;
+  }
+  count(&Counters::publishes);
+  count(&Counters::publishBytes, strlen(topic) + length);
+  return true;
+}
+
+// A slow random walk for the analog values and occasional actuator
+// transitions, which is roughly what a settled chamber reports.
+static void simulate(Node* node, uint64_t now) {
+  int32_t* v = node->values;
+  v[FIELD_TEMPERATURE] += rand() % 3 - 1;
+  v[FIELD_HUMIDITY] += rand() % 5 - 2;
+  v[FIELD_DEWPOINT] = dewPoint(v[FIELD_TEMPERATURE], v[FIELD_HUMIDITY]);
+  v[FIELD_VPD] = vapourPressureDeficit(v[FIELD_TEMPERATURE], v[FIELD_HUMIDITY]);
+  v[FIELD_ABSHUMIDITY] = absoluteHumidity(v[FIELD_TEMPERATURE], v[FIELD_HUMIDITY]);
+  v[FIELD_ELAPSED] = now / 86400000000ULL;
+  if (rand() % 20 == 0)
+    v[FIELD_HEATER] = !v[FIELD_HEATER];
+  if (rand() % 20 == 0)
+    v[FIELD_HUMIDIFIER] = !v[FIELD_HUMIDIFIER];
+}
+
+// Same topics and payload formats as sendStatus() in src/main.cpp.
+static void sendStatus(Node* node, uint64_t now) {
+  int32_t* v = node->values;
+  simulate(node, now);
+
+  bool force = !opt.onChange || node->forceReport || now - node->lastHeartbeat >= HEARTBEAT_INTERVAL * 1000000ULL;
+  if (force) {
+    node->forceReport = false;
+    node->lastHeartbeat = now;
+  }
+
+  if (opt.snapshot) {
+    bool due = force;
+    for (unsigned i = 0; i < TEXT_FIELDS; i++)
+      due = due || node->reports[textFields[i]].changed(v[textFields[i]]);
+    if (!due)
+      return;
+
+    StatusSnapshot s;
+    uint8_t buf[STATUS_SNAPSHOT_SIZE];
+    s.temperature = v[FIELD_TEMPERATURE];
+    s.humidity = v[FIELD_HUMIDITY];
+    s.dewPoint = v[FIELD_DEWPOINT];
+    s.vpd = v[FIELD_VPD];
+    s.absHumidity = v[FIELD_ABSHUMIDITY];
+    s.daysElapsed = v[FIELD_ELAPSED];
+    s.startEpochTime = v[FIELD_ELAPSED2];
+    s.epoch = s.startEpochTime + now / 1000000;
+    s.flags = STATUS_FLAG_RUNNING;
+    if (v[FIELD_HEATER])
+      s.flags |= STATUS_FLAG_HEATER;
+    if (v[FIELD_HUMIDIFIER])
+      s.flags |= STATUS_FLAG_HUMIDIFIER;
+    if (v[FIELD_FAN1])
+      s.flags |= STATUS_FLAG_FAN1;
+    if (v[FIELD_FAN2])
+      s.flags |= STATUS_FLAG_FAN2;
+    if (publish(node, FIELD_SNAPSHOT, buf, encodeStatusSnapshot(s, buf)))
+      for (unsigned i = 0; i < TEXT_FIELDS; i++)
+        node->reports[textFields[i]].set(v[textFields[i]]);
+    return;
+  }
+
+  for (unsigned i = 0; i < TEXT_FIELDS; i++) {
+    uint8_t field = textFields[i];
+    if (!force && !node->reports[field].changed(v[field]))
+      continue;
+    char msg[TELEMETRY_VALUE_SIZE];
+    uint8_t length;
+    if (field == FIELD_TEMPERATURE || field == FIELD_HUMIDITY
+        || field == FIELD_DEWPOINT || field == FIELD_ABSHUMIDITY)
+      length = formatDeci(v[field], msg);
+    else
+      length = formatInt(v[field], msg);
+    if (publish(node, field, (const uint8_t*)msg, length))
+      node->reports[field].set(v[field]);
+  }
+}
+
+static bool connectNode(Node* node, uint64_t now) {
+  uint64_t start = now64();
+  bool ok = node->mqtt.connect(node->id);
+  uint64_t elapsed = now64() - start;
+  count(&Counters::connectTime, elapsed);
+  if (elapsed > total.maxConnectTime)
+    total.maxConnectTime = elapsed;
+  if (elapsed > window.maxConnectTime)
+    window.maxConnectTime = elapsed;
+
+  if (!ok) {
+    count(&Counters::connectFailures);
+    node->nextConnect = now + NETWORK_INTERVAL;
+    return false;
+  }
+
+  char topic[20];
+  snprintf(topic, sizeof(topic), "%s/set/#", node->id);
+  node->mqtt.subscribe(topic, 1);
+  count(&Counters::connects);
+  node->online = true;
+  node->forceReport = true;
+  online++;
+  return true;
+}
+
+static void dropNode(Node* node, uint64_t now) {
+  node->online = false;
+  online--;
+  count(&Counters::losses);
+  if (node->commandSent) {
+    count(&Counters::commandsLost);
+    node->commandSent = 0;
+  }
+  // The firmware notices a lost connection on its next network task run.
+  node->nextConnect = now + (uint64_t)rand() % NETWORK_INTERVAL;
+}
+
+static int findBroker() {
+  DIR* dir = opendir("/proc");
+  if (!dir)
+    return -1;
+
+  int pid = -1;
+  struct dirent* entry;
+  while (pid < 0 && (entry = readdir(dir)) != NULL) {
+    char path[300], comm[64] = "";
+    snprintf(path, sizeof(path), "/proc/%s/comm", entry->d_name);
+    FILE* f = fopen(path, "r");
+    if (!f)
+      continue;
+    if (fgets(comm, sizeof(comm), f) && strncmp(comm, "mosquitto", 9) == 0)
+      pid = atoi(entry->d_name);
+    fclose(f);
+  }
+  closedir(dir);
+  return pid;
+}
+
+// CPU time in clock ticks and resident memory in kB of a process.
+static bool processUsage(int pid, uint64_t* ticks, uint64_t* rssKb) {
+  char path[64], buf[1024];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return false;
+  size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[n] = 0;
+
+  // Fields after the command name, which may contain spaces.
+  char* p = strrchr(buf, ')');
+  if (!p)
+    return false;
+  unsigned long utime, stime;
+  long rss;
+  if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d %*u %*u %ld",
+             &utime, &stime, &rss) != 3)
+    return false;
+  *ticks = utime + stime;
+  *rssKb = rss * (sysconf(_SC_PAGESIZE) / 1024);
+  return true;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& v, double p) {
+  if (v.empty())
+    return 0;
+  size_t i = (size_t)(p * (v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + i, v.end());
+  return v[i];
+}
+
+static void printLatency(const char* label, std::vector<uint32_t>& v) {
+  if (v.empty()) {
+    printf("%s -", label);
+    return;
+  }
+  uint32_t max = *std::max_element(v.begin(), v.end());
+  printf("%s p50 %.2f p95 %.2f p99 %.2f max %.2f ms", label,
+         percentile(v, 0.50) / 1000.0, percentile(v, 0.95) / 1000.0,
+         percentile(v, 0.99) / 1000.0, max / 1000.0);
+}
+
+static void usage(const char* name) {
+  printf("usage: %s [options]\n"
+         "  --host HOST       broker address (default 127.0.0.1)\n"
+         "  --port PORT       (default 1883)\n"
+         "  --nodes N         virtual nodes (default 100)\n"
+         "  --duration S      (default 60)\n"
+         "  --interval S      node report interval (default 5, REPORT_INTERVAL)\n"
+         "  --cmd-rate R      commands per second sent by the controller (default 10)\n"
+         "  --subscribe       controller subscribes to +/status/#\n"
+         "  --snapshot        nodes publish one binary status snapshot per report\n"
+         "  --on-change       nodes only publish changed fields, plus a heartbeat\n"
+         "  --storm-at S      drop every node connection at S seconds\n"
+         "  --ramp N          node connections per second at start (default 200, 0 = all)\n"
+         "  --report S        report period (default 5)\n"
+         "  --broker-pid PID  broker process (default: first process named mosquitto)\n", name);
+}
+
+int main(int argc, char** argv) {
+  opt.host = "127.0.0.1";
+  opt.port = 1883;
+  opt.nodes = 100;
+  opt.duration = 60;
+  opt.interval = 5;
+  opt.cmdRate = 10;
+  opt.subscribe = false;
+  opt.snapshot = false;
+  opt.onChange = false;
+  opt.stormAt = -1;
+  opt.ramp = 200;
+  opt.report = 5;
+  opt.brokerPid = -1;
+
+  static const struct option longOptions[] = {
+    {"host",       required_argument, 0, 'h'},
+    {"port",       required_argument, 0, 'p'},
+    {"nodes",      required_argument, 0, 'n'},
+    {"duration",   required_argument, 0, 'd'},
+    {"interval",   required_argument, 0, 'i'},
+    {"cmd-rate",   required_argument, 0, 'c'},
+    {"subscribe",  no_argument,       0, 's'},
+    {"snapshot",   no_argument,       0, 'B'},
+    {"on-change",  no_argument,       0, 'D'},
+    {"storm-at",   required_argument, 0, 'S'},
+    {"ramp",       required_argument, 0, 'r'},
+    {"report",     required_argument, 0, 'R'},
+    {"broker-pid", required_argument, 0, 'b'},
+    {"help",       no_argument,       0, '?'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (c) {
+      case 'h': opt.host = optarg; break;
+      case 'p': opt.port = atoi(optarg); break;
+      case 'n': opt.nodes = atoi(optarg); break;
+      case 'd': opt.duration = atoi(optarg); break;
+      case 'i': opt.interval = atoi(optarg); break;
+      case 'c': opt.cmdRate = atof(optarg); break;
+      case 's': opt.subscribe = true; break;
+      case 'B': opt.snapshot = true; break;
+      case 'D': opt.onChange = true; break;
+      case 'S': opt.stormAt = atoi(optarg); break;
+      case 'r': opt.ramp = atoi(optarg); break;
+      case 'R': opt.report = atoi(optarg); break;
+      case 'b': opt.brokerPid = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (opt.interval == 0 || opt.report == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // One socket per node.
+  struct rlimit lim;
+  if (getrlimit(RLIMIT_NOFILE, &lim) == 0) {
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+    if (lim.rlim_cur < opt.nodes + 16)
+      fprintf(stderr, "warning: open file limit %lu is below the node count\n", (unsigned long)lim.rlim_cur);
+  }
+
+  if (opt.brokerPid < 0)
+    opt.brokerPid = findBroker();
+  if (opt.brokerPid < 0)
+    fprintf(stderr, "warning: broker process not found, CPU usage will not be reported\n");
+
+  srand(1);
+  uint64_t start = now64();
+  uint64_t intervalUs = (uint64_t)opt.interval * 1000000ULL;
+
+  nodes.resize(opt.nodes);
+  for (uint32_t i = 0; i < opt.nodes; i++) {
+    Node* node = new Node();
+    snprintf(node->id, sizeof(node->id), "%06X", FLEET_ID_BASE + i);
+    node->telemetry.begin(node->id);
+    node->mqtt.setServer(opt.host, opt.port);
+    node->mqtt.setCallback(nodeCallback);
+    node->nextConnect = start + (opt.ramp ? (uint64_t)i * 1000000ULL / opt.ramp : 0);
+    node->nextPublish = node->nextConnect + (uint64_t)rand() % intervalUs;
+    node->commandSent = 0;
+    node->online = false;
+    node->values[FIELD_TEMPERATURE] = 250;
+    node->values[FIELD_HUMIDITY] = 850;
+    node->values[FIELD_ELAPSED] = 0;
+    node->values[FIELD_ELAPSED2] = 1530000000;
+    node->values[FIELD_HEATER] = 0;
+    node->values[FIELD_HUMIDIFIER] = 0;
+    node->values[FIELD_FAN1] = 1;
+    node->values[FIELD_FAN2] = 1;
+    node->lastHeartbeat = 0;
+    node->forceReport = true;
+    nodes[i] = node;
+  }
+
+  PosixClient   controllerNet;
+  PubSubClient  controller(controllerNet);
+  controller.setServer(opt.host, opt.port);
+  controller.setCallback(controllerCallback);
+  if (!controller.connect("fleet-controller")) {
+    fprintf(stderr, "cannot connect to %s:%u (rc=%d)\n", opt.host, opt.port, controller.state());
+    return 1;
+  }
+  if (opt.subscribe)
+    controller.subscribe("+/status/#");
+
+  uint64_t end = start + (uint64_t)opt.duration * 1000000ULL;
+  uint64_t nextReport = start + (uint64_t)opt.report * 1000000ULL;
+  uint64_t nextKeepalive = start;
+  uint64_t stormTime = opt.stormAt >= 0 ? start + (uint64_t)opt.stormAt * 1000000ULL : 0;
+  uint64_t stormRecovered = 0;
+  bool     stormActive = false;
+  double   commandBudget = 0;
+  uint64_t lastPass = start;
+
+  uint64_t brokerTicks = 0, brokerRss = 0;
+  if (opt.brokerPid > 0)
+    processUsage(opt.brokerPid, &brokerTicks, &brokerRss);
+  uint64_t lastReport = start;
+  long ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+  std::vector<struct pollfd> fds;
+  std::vector<Node*> polled;
+
+  printf("%u nodes, %s:%u, report every %u s, %.1f commands/s\n",
+         opt.nodes, opt.host, opt.port, opt.interval, opt.cmdRate);
+
+  for (uint64_t now = now64(); now < end; now = now64()) {
+    if (stormTime && now >= stormTime) {
+      printf("-- reconnect storm: dropping %u connections\n", online);
+      for (uint32_t i = 0; i < opt.nodes; i++) {
+        if (nodes[i]->online) {
+          nodes[i]->net.abort();
+          dropNode(nodes[i], now);
+        }
+      }
+      stormTime = 0;
+      stormActive = true;
+    }
+
+    // Connection handling, like taskNetwork() in the firmware.
+    for (uint32_t i = 0; i < opt.nodes; i++) {
+      Node* node = nodes[i];
+      if (node->online && !node->mqtt.connected())
+        dropNode(node, now);
+      if (!node->online && now >= node->nextConnect)
+        connectNode(node, now);
+    }
+    if (stormActive && online == opt.nodes) {
+      stormRecovered = now - start - (uint64_t)opt.stormAt * 1000000ULL;
+      printf("-- reconnect storm: all nodes back after %.2f s\n", stormRecovered / 1e6);
+      stormActive = false;
+    }
+
+    // Telemetry, like taskTelemetry().
+    for (uint32_t i = 0; i < opt.nodes; i++) {
+      Node* node = nodes[i];
+      if (now < node->nextPublish)
+        continue;
+      if (node->online)
+        sendStatus(node, now - start);
+      node->nextPublish += intervalUs;
+    }
+
+    // Commands from the server side.
+    commandBudget += opt.cmdRate * (now - lastPass) / 1e6;
+    lastPass = now;
+    for (int tries = 0; commandBudget >= 1 && online > 0 && tries < 100; tries++) {
+      Node* node = nodes[rand() % opt.nodes];
+      if (!node->online || node->commandSent)
+        continue;
+      char topic[40];
+      snprintf(topic, sizeof(topic), "%s/set/temperature", node->id);
+      node->commandSent = now64();
+      if (controller.publish(topic, "25.0"))
+        count(&Counters::commands);
+      else
+        node->commandSent = 0;
+      commandBudget -= 1;
+    }
+
+    // Wait for inbound traffic, then service the nodes that have some and,
+    // once a second, all of them for the MQTT keepalive.
+    fds.clear();
+    polled.clear();
+    for (uint32_t i = 0; i < opt.nodes; i++) {
+      if (nodes[i]->online) {
+        struct pollfd p = { nodes[i]->net.fd(), POLLIN, 0 };
+        fds.push_back(p);
+        polled.push_back(nodes[i]);
+      }
+    }
+    struct pollfd p = { controllerNet.fd(), POLLIN, 0 };
+    fds.push_back(p);
+    poll(&fds[0], fds.size(), 2);
+
+    bool keepalive = now >= nextKeepalive;
+    if (keepalive)
+      nextKeepalive = now + 1000000ULL;
+    for (size_t i = 0; i < polled.size(); i++) {
+      if (keepalive || (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+        Node* node = polled[i];
+        do {
+          node->mqtt.loop();
+        } while (node->net.available());
+      }
+    }
+    do {
+      controller.loop();
+    } while (controllerNet.available());
+    if (!controller.connected()) {
+      fprintf(stderr, "controller lost the broker connection\n");
+      break;
+    }
+
+    if (now >= nextReport) {
+      double seconds = (now - lastReport) / 1e6;
+      printf("[%5.0f s] online %u  pub %.0f/s  delivered %.0f/s  cmd %lu  ",
+             (now - start) / 1e6, online, window.publishes / seconds, window.delivered / seconds,
+             (unsigned long)window.commands);
+      printLatency("latency", windowLatencies);
+
+      uint64_t ticks, rss;
+      if (opt.brokerPid > 0 && processUsage(opt.brokerPid, &ticks, &rss)) {
+        printf("  broker %.1f%% cpu %lu kB", 100.0 * (ticks - brokerTicks) / ticksPerSecond / seconds,
+               (unsigned long)rss);
+        brokerTicks = ticks;
+      }
+      if (window.connects || window.losses || window.connectFailures)
+        printf("  connects %lu (failed %lu, max %.1f ms) lost %lu", (unsigned long)window.connects,
+               (unsigned long)window.connectFailures, window.maxConnectTime / 1000.0,
+               (unsigned long)window.losses);
+      printf("\n");
+      fflush(stdout);
+
+      memset(&window, 0, sizeof(window));
+      windowLatencies.clear();
+      lastReport = now;
+      nextReport += (uint64_t)opt.report * 1000000ULL;
+    }
+  }
+
+  double seconds = (now64() - start) / 1e6;
+  printf("\nsummary over %.1f s\n", seconds);
+  printf("  publishes        %lu (%.0f/s, %.0f B/s topic+payload, %lu failed)\n",
+         (unsigned long)total.publishes, total.publishes / seconds, total.publishBytes / seconds,
+         (unsigned long)total.publishFailures);
+  printf("  delivered        %lu (%.0f/s)\n", (unsigned long)total.delivered, total.delivered / seconds);
+  if (total.decodeErrors)
+    printf("  decode errors    %lu\n", (unsigned long)total.decodeErrors);
+  printf("  commands         %lu (%lu lost on disconnect, %lu unanswered)\n",
+         (unsigned long)total.commands, (unsigned long)total.commandsLost,
+         (unsigned long)(total.commands - total.commandsLost - latencies.size()));
+  printLatency("  command latency ", latencies);
+  printf("\n");
+  printf("  connects         %lu (mean %.2f ms, max %.2f ms), %lu failed, %lu lost\n",
+         (unsigned long)total.connects,
+         total.connects ? total.connectTime / 1000.0 / (total.connects + total.connectFailures) : 0.0,
+         total.maxConnectTime / 1000.0, (unsigned long)total.connectFailures, (unsigned long)total.losses);
+  if (opt.stormAt >= 0)
+    printf("  storm recovery   %s%.2f s\n", stormRecovered ? "" : "not recovered, ",
+           stormRecovered / 1e6);
+
+  for (uint32_t i = 0; i < opt.nodes; i++) {
+    if (nodes[i]->online)
+      nodes[i]->mqtt.disconnect();
+    delete nodes[i];
+  }
+  controller.disconnect();
+  return 0;
+}
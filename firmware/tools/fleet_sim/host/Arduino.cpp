@@ -0,0 +1,22 @@
+/*
+ Arduino.cpp - Time functions of the minimal Linux Arduino core.
+*/
+
+#include "Arduino.h"
+
+#include <time.h>
+
+static uint64_t monotonicMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// Truncated to 32 bits so the wrap-around matches the ESP8266.
+unsigned long millis() {
+  return (uint32_t)(monotonicMicros() / 1000);
+}
+
+unsigned long micros() {
+  return (uint32_t)monotonicMicros();
+}
@@ -0,0 +1,25 @@
+/*
+ Arduino.h - Minimal Arduino core for building PubSubClient on Linux.
+
+ Only what PubSubClient uses is provided.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define pgm_read_byte_near(address) (*(const uint8_t*)(address))
+
+unsigned long millis();
+unsigned long micros();
+
+#include "Print.h"
+
+#endif
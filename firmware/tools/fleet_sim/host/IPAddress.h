@@ -0,0 +1,22 @@
+/*
+ IPAddress.h - Minimal Arduino IPAddress for Linux builds.
+*/
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+
+class IPAddress {
+  public:
+    IPAddress() { _address[0] = _address[1] = _address[2] = _address[3] = 0; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+      _address[0] = a; _address[1] = b; _address[2] = c; _address[3] = d;
+    }
+    uint8_t operator[](int index) const { return _address[index]; }
+
+  private:
+    uint8_t _address[4];
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ PosixClient.cpp - Arduino Client over a Linux TCP socket.
+*/
+
+#include "PosixClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+PosixClient::PosixClient() {
+  _fd = -1;
+  _closed = true;
+  _rxPos = _rxLen = 0;
+}
+
+PosixClient::~PosixClient() {
+  stop();
+}
+
+int PosixClient::connect(IPAddress ip, uint16_t port) {
+  char host[16];
+  snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return connect(host, port);
+}
+
+int PosixClient::connect(const char* host, uint16_t port) {
+  stop();
+
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo* res;
+  if (getaddrinfo(host, service, &hints, &res) != 0)
+    return 0;
+
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0) {
+    freeaddrinfo(res);
+    return 0;
+  }
+
+  if (::connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    freeaddrinfo(res);
+    close(fd);
+    return 0;
+  }
+  freeaddrinfo(res);
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  _fd = fd;
+  _closed = false;
+  _rxPos = _rxLen = 0;
+  return 1;
+}
+
+size_t PosixClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t PosixClient::write(const uint8_t* buf, size_t size) {
+  size_t sent = 0;
+  while (!_closed && sent < size) {
+    ssize_t n = send(_fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      struct pollfd p = { _fd, POLLOUT, 0 };
+      poll(&p, 1, 100);
+    } else {
+      _closed = true;
+    }
+  }
+  return sent;
+}
+
+bool PosixClient::fill() {
+  if (_rxPos < _rxLen)
+    return true;
+  if (_closed)
+    return false;
+
+  ssize_t n = recv(_fd, _rx, sizeof(_rx), MSG_DONTWAIT);
+  if (n > 0) {
+    _rxPos = 0;
+    _rxLen = n;
+    return true;
+  }
+  if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    _closed = true;
+  return false;
+}
+
+int PosixClient::available() {
+  if (!fill())
+    return 0;
+  return _rxLen - _rxPos;
+}
+
+int PosixClient::read() {
+  if (!fill())
+    return -1;
+  return _rx[_rxPos++];
+}
+
+int PosixClient::read(uint8_t* buf, size_t size) {
+  size_t n = 0;
+  while (n < size && fill()) {
+    size_t chunk = _rxLen - _rxPos;
+    if (chunk > size - n)
+      chunk = size - n;
+    memcpy(buf + n, _rx + _rxPos, chunk);
+    _rxPos += chunk;
+    n += chunk;
+  }
+  return n;
+}
+
+int PosixClient::peek() {
+  if (!fill())
+    return -1;
+  return _rx[_rxPos];
+}
+
+void PosixClient::flush() {
+}
+
+void PosixClient::stop() {
+  if (_fd >= 0)
+    close(_fd);
+  _fd = -1;
+  _closed = true;
+  _rxPos = _rxLen = 0;
+}
+
+void PosixClient::abort() {
+  if (_fd >= 0) {
+    struct linger l = { 1, 0 };
+    setsockopt(_fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+  }
+  stop();
+}
+
+// A closed socket is only noticed by the next read, so that polling the
+// connection state does not cost a system call.
+uint8_t PosixClient::connected() {
+  return !_closed || _rxPos < _rxLen;
+}
+
+PosixClient::operator bool() {
+  return _fd >= 0;
+}
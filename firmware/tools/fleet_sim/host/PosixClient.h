@@ -0,0 +1,51 @@
+/*
+ PosixClient.h - Arduino Client over a Linux TCP socket.
+
+ Writes block until the whole buffer is handed to the kernel, reads never
+ block, like WiFiClient on the ESP8266.
+*/
+
+#ifndef PosixClient_h
+#define PosixClient_h
+
+#include "Client.h"
+
+#define POSIX_CLIENT_RX_SIZE 512
+
+class PosixClient : public Client {
+  public:
+    PosixClient();
+    ~PosixClient();
+
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char* host, uint16_t port);
+    size_t write(uint8_t b);
+    size_t write(const uint8_t* buf, size_t size);
+    int available();
+    int read();
+    int read(uint8_t* buf, size_t size);
+    int peek();
+    void flush();
+    void stop();
+    uint8_t connected();
+    operator bool();
+
+    /**
+     * Drops the connection without a FIN handshake (SO_LINGER 0), the way a
+     * router reboot or WiFi loss looks to the broker.
+     */
+    void abort();
+
+    int fd() const { return _fd; }
+
+  private:
+    int       _fd;
+    bool      _closed;
+    uint8_t   _rx[POSIX_CLIENT_RX_SIZE];
+    uint16_t  _rxPos;
+    uint16_t  _rxLen;
+
+    bool fill();
+};
+
+#endif
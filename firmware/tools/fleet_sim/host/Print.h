@@ -0,0 +1,23 @@
+/*
+ Print.h - Minimal Arduino Print for Linux builds.
+*/
+
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+      size_t n = 0;
+      while (size--)
+        n += write(*buffer++);
+      return n;
+    }
+};
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ telemetry_bench.cpp - Cost of building one status publish on the host.
+
+ Compares the sprintf() path sendStatus() used before (topic rebuilt with
+ "%s/status/..." and values printed with "%.1f"/"%d") with TelemetryEncoder
+ (topic table built once, integer formatting). Both paths produce the eight
+ text fields of a status report for varying readings and hand topic and
+ payload to a sink that stands in for MQTT.publish().
+
+ The host has an FPU, so the gap on the ESP8266, where "%.1f" runs in soft
+ float, is larger than what is measured here.
+
+ Build and run with PlatformIO:
+   pio run -e telemetry_bench
+   .pio/build/telemetry_bench/program
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include <TelemetryEncoder.h>
+
+#define READINGS    1024
+#define ITERATIONS  200000
+
+static const char* espID = "A1B2C3";
+static volatile uint32_t sink;
+
+static float    temperatures[READINGS];
+static float    humidities[READINGS];
+static int32_t  states[READINGS];
+
+__attribute__((noinline)) static void publish(const char* topic, const char* payload) {
+  sink += strlen(topic) + strlen(payload);
+}
+
+static void legacyReport(uint32_t i) {
+  char topic[40];   // sendStatus() had 20, too short for "ESPID/status/temperature"
+  char msg[50];
+  int32_t state = states[i];
+
+  sprintf(msg, "%.1f", temperatures[i]);
+  sprintf(topic, "%s/status/temperature", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%.1f", humidities[i]);
+  sprintf(topic, "%s/status/humidity", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%d", (int)(i % 60));
+  sprintf(topic, "%s/status/elapsed", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%d", 1530000000 + (int)i);
+  sprintf(topic, "%s/status/elapsed2", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%d", state & 1);
+  sprintf(topic, "%s/status/heater", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%d", (state >> 1) & 1);
+  sprintf(topic, "%s/status/humidifier", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%d", (state >> 2) & 1);
+  sprintf(topic, "%s/status/fan1", espID);
+  publish(topic, msg);
+
+  sprintf(msg, "%d", (state >> 3) & 1);
+  sprintf(topic, "%s/status/fan2", espID);
+  publish(topic, msg);
+}
+
+static TelemetryEncoder telemetry;
+
+static int32_t toTenths(float value) {
+  return (int32_t)(value * 10 + (value >= 0 ? 0.5f : -0.5f));
+}
+
+static void encoderReport(uint32_t i) {
+  char msg[TELEMETRY_VALUE_SIZE];
+  int32_t state = states[i];
+
+  formatDeci(toTenths(temperatures[i]), msg);
+  publish(telemetry.topic(FIELD_TEMPERATURE), msg);
+
+  formatDeci(toTenths(humidities[i]), msg);
+  publish(telemetry.topic(FIELD_HUMIDITY), msg);
+
+  formatInt(i % 60, msg);
+  publish(telemetry.topic(FIELD_ELAPSED), msg);
+
+  formatInt(1530000000 + i, msg);
+  publish(telemetry.topic(FIELD_ELAPSED2), msg);
+
+  formatInt(state & 1, msg);
+  publish(telemetry.topic(FIELD_HEATER), msg);
+
+  formatInt((state >> 1) & 1, msg);
+  publish(telemetry.topic(FIELD_HUMIDIFIER), msg);
+
+  formatInt((state >> 2) & 1, msg);
+  publish(telemetry.topic(FIELD_FAN1), msg);
+
+  formatInt((state >> 3) & 1, msg);
+  publish(telemetry.topic(FIELD_FAN2), msg);
+}
+
+static uint64_t nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cycles() {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void run(const char* name, void (*report)(uint32_t)) {
+  for (uint32_t i = 0; i < READINGS; i++)   // warm up
+    report(i);
+
+  uint64_t t0 = nanos();
+  uint64_t c0 = cycles();
+  for (uint32_t i = 0; i < ITERATIONS; i++)
+    report(i % READINGS);
+  uint64_t c1 = cycles();
+  uint64_t t1 = nanos();
+
+  double publishes = ITERATIONS * 8.0;
+  printf("%-10s %8.1f ns/publish", name, (t1 - t0) / publishes);
+#ifdef HAVE_TSC
+  printf("  %8.1f cycles/publish", (c1 - c0) / publishes);
+#endif
+  printf("\n");
+}
+
+int main() {
+  srand(1);
+  for (uint32_t i = 0; i < READINGS; i++) {
+    temperatures[i] = 15.0f + (rand() % 2000) / 100.0f;
+    humidities[i] = 60.0f + (rand() % 4000) / 100.0f;
+    states[i] = rand() & 0xF;
+  }
+
+  // Both paths print the same text, except for values that fall halfway
+  // between two tenths: toTenths() rounds them up after the float multiply,
+  // "%.1f" rounds the exact binary value, which is often just below.
+  char a[50], b[TELEMETRY_VALUE_SIZE];
+  uint32_t differ = 0;
+  for (uint32_t i = 0; i < READINGS; i++) {
+    sprintf(a, "%.1f", temperatures[i]);
+    formatDeci(toTenths(temperatures[i]), b);
+    if (strcmp(a, b) != 0)
+      differ++;
+  }
+  printf("%u of %u readings differ in the last digit (halfway cases)\n", differ, READINGS);
+
+  telemetry.begin(espID);
+  run("sprintf", legacyReport);
+  run("encoder", encoderReport);
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ Chamber.cpp - Thermal and humidity model of the foam box.
+*/
+
+#include "Chamber.h"
+
+#include <math.h>
+#include <Controller.h>
+
+void defaultChamberParams(ChamberParams& p) {
+  p.ambientTemperature = 20.0;
+  p.ambientHumidity    = 60.0;
+  p.boxLoss            = 0.001225;
+  p.boxCapacity        = 2000.0;
+  p.heaterPower        = 50.0;
+  p.waterCapacity      = 4186.0;   // 1 L of water
+  p.waterCoupling      = 2.0;
+  p.chamberVolume      = 0.030;    // 30 L box
+  p.foggerRate         = 0.002;
+  p.airExchange        = 0.0005;
+  p.sensorNoiseT       = 0.1;
+  p.sensorNoiseH       = 0.5;
+  p.sensorFailure      = 0.01;
+  p.sensorSpike        = 0;
+}
+
+double saturationVapour(double t) {
+  double es = 6.112 * exp(17.62 * t / (243.12 + t));   // in hPa
+  return 216.7 * es / (273.15 + t);
+}
+
+Chamber::Chamber(const ChamberParams& params, uint32_t seed)
+  : _p(params), _rng(seed), _noise(0.0, 1.0), _uniform(0.0, 1.0) {
+  _air = _p.ambientTemperature;
+  _water = _p.ambientTemperature;
+  _vapour = saturationVapour(_p.ambientTemperature) * _p.ambientHumidity / 100.0;
+}
+
+void Chamber::step(double dt, bool heater, bool humidifier) {
+  double toAir  = _p.waterCoupling * (_water - _air);
+  double toRoom = _p.boxLoss * _p.boxCapacity * (_air - _p.ambientTemperature);
+
+  _water += dt * ((heater ? _p.heaterPower : 0.0) - toAir) / _p.waterCapacity;
+  _air   += dt * (toAir - toRoom) / _p.boxCapacity;
+
+  double roomVapour = saturationVapour(_p.ambientTemperature) * _p.ambientHumidity / 100.0;
+  double injected = humidifier ? _p.foggerRate / _p.chamberVolume : 0.0;
+  _vapour += dt * (injected - _p.airExchange * (_vapour - roomVapour));
+
+  // Anything above saturation condenses on the walls.
+  double saturation = saturationVapour(_air);
+  if (_vapour > saturation)
+    _vapour = saturation;
+}
+
+double Chamber::humidity() const {
+  return 100.0 * _vapour / saturationVapour(_air);
+}
+
+// Draws nothing without spikes, so runs stay comparable with older ones.
+bool Chamber::spike() {
+  return _p.sensorSpike > 0 && _uniform(_rng) < _p.sensorSpike;
+}
+
+int16_t Chamber::quantize(double value) {
+  return (int16_t)lround(value * 10.0);
+}
+
+int16_t Chamber::readTemperature() {
+  if (_uniform(_rng) < _p.sensorFailure)
+    return SENSOR_NO_READING;
+  if (spike())
+    return quantize(-40.0 + 120.0 * _uniform(_rng));
+  return quantize(_air + _p.sensorNoiseT * _noise(_rng));
+}
+
+int16_t Chamber::readHumidity() {
+  if (_uniform(_rng) < _p.sensorFailure)
+    return SENSOR_NO_READING;
+  if (spike())
+    return quantize(99.9 * _uniform(_rng));
+  double h = humidity() + _p.sensorNoiseH * _noise(_rng);
+  if (h > 99.9)
+    h = 99.9;
+  if (h < 0.0)
+    h = 0.0;
+  return quantize(h);
+}
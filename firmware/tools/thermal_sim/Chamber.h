@@ -0,0 +1,77 @@
+/*
+ Chamber.h - Thermal and humidity model of the foam box.
+
+ Three state variables integrated with a fixed step:
+  - water reservoir temperature, heated by the aquarium heater
+  - chamber air temperature, exchanging heat with the reservoir and losing
+    it to ambient with the box constant k measured in the README
+    (T(t)=28.3+18.15*exp(-0.001225*t), k = 0.001225 1/s)
+  - absolute humidity of the chamber air, raised by the fogger and lost
+    through air exchange with the room
+*/
+
+#ifndef Chamber_h
+#define Chamber_h
+
+#include <stdint.h>
+#include <random>
+
+struct ChamberParams {
+  double  ambientTemperature;   // in Celsius
+  double  ambientHumidity;      // in %RH
+  double  boxLoss;              // k, in 1/s
+  double  boxCapacity;          // heat capacity of air, box and substrate, in J/K
+  double  heaterPower;          // in W
+  double  waterCapacity;        // heat capacity of the reservoir, in J/K
+  double  waterCoupling;        // reservoir to air conductance, in W/K
+  double  chamberVolume;        // in m^3
+  double  foggerRate;           // vapour injected while the fogger is on, in g/s
+  double  airExchange;          // fraction of the air replaced per second, in 1/s
+  double  sensorNoiseT;         // standard deviation, in Celsius
+  double  sensorNoiseH;         // standard deviation, in %RH
+  double  sensorFailure;        // probability of a failed read
+  double  sensorSpike;          // probability of a valid frame with a random value
+};
+
+void defaultChamberParams(ChamberParams& p);
+
+class Chamber {
+  public:
+    Chamber(const ChamberParams& params, uint32_t seed);
+
+    /**
+     * Advances the model by dt seconds with the given actuator states.
+     */
+    void step(double dt, bool heater, bool humidifier);
+
+    /**
+     * Simulates a DHT22 read: true value plus noise, in 0.1 units like
+     * DhtSample. Failed reads return SENSOR_NO_READING; spikes return any
+     * value of the sensor range.
+     */
+    int16_t readTemperature();
+    int16_t readHumidity();
+
+    double  temperature() const { return _air; }
+    double  waterTemperature() const { return _water; }
+    double  humidity() const;
+
+  private:
+    ChamberParams _p;
+    double        _air;
+    double        _water;
+    double        _vapour;    // absolute humidity, in g/m^3
+    std::mt19937  _rng;
+    std::normal_distribution<double>        _noise;
+    std::uniform_real_distribution<double>  _uniform;
+
+    int16_t quantize(double value);
+    bool  spike();
+};
+
+/**
+ * Saturation absolute humidity (Magnus formula), in g/m^3.
+ */
+double saturationVapour(double t);
+
+#endif
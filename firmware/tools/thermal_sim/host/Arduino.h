@@ -0,0 +1,18 @@
+/*
+ Arduino.h - Just enough of the Arduino core to build the Actuator library
+ into the simulator: the pins go nowhere.
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+
+#define LOW     0
+#define HIGH    1
+#define OUTPUT  1
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+#endif
@@ -0,0 +1,356 @@
+/*
+ thermal_sim.cpp - Runs the firmware control logic against a simulated chamber.
+
+ The Controller library is the same code that runs on the ESP8266. It is fed
+ simulated DHT22 readings at the firmware sensor and control periods while
+ the Chamber model is integrated with a fixed step, so days of grow time run
+ in seconds. Its outputs go through Actuator with the firmware's minimum on
+ and off times, as the relays do. At the end overshoot, settling time and actuator switching are
+ reported; a CSV trace can be written for plotting.
+
+ Build and run with PlatformIO:
+   pio run -e thermal_sim
+   .pio/build/thermal_sim/program --days 7 --set-temp 25 --csv trace.csv
+*/
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Controller.h>
+#include <Actuator.h>
+#include "Chamber.h"
+
+#define START_EPOCH 1530000000UL
+
+struct Options {
+  double    days;
+  double    step;             // plant integration step, in s
+  uint32_t  sensorPeriod;     // in ms
+  uint32_t  controlPeriod;    // in ms
+  double    band;             // settling band, in Celsius
+  double    stepAt;           // setpoint step time, in s (0 for none)
+  double    stepTemperature;
+  uint32_t  seed;
+  const char* csv;
+  uint32_t  csvStep;          // in s
+};
+
+struct Stats {
+  uint32_t  heaterSwitches;
+  uint32_t  humidifierSwitches;
+  double    heaterOnTime;     // in s
+  double    humidifierOnTime; // in s
+  double    reachedAt;        // first time the setpoint was reached, in s (-1 if never)
+  double    lastOutOfBand;    // in s
+  double    maxTemperature;   // after reaching the setpoint
+  double    minTemperature;   // after reaching the setpoint
+  double    sqError;          // accumulated after reaching the setpoint
+  double    sqErrorTime;
+  double    minHumidity;      // after reaching the setpoint
+  double    maxHumidity;
+  double    sumHumidity;
+  double    stepLastOutOfBand;  // in s after the setpoint step
+  double    stepOvershoot;      // in Celsius over the new setpoint
+};
+
+static void usage(const char* name) {
+  printf("usage: %s [options]\n"
+         "  --days N              simulated time (default 7)\n"
+         "  --step S              plant integration step in s (default 1)\n"
+         "  --sensor-period MS    (default 5000)\n"
+         "  --control-period MS   (default 5000)\n"
+         "  --set-temp C          (default 25)\n"
+         "  --set-hum RH          (default 85)\n"
+         "  --set-vpd KPA         hold a vapour pressure deficit instead of --set-hum\n"
+         "  --hum-period MIN      humidifier period (default 0, disabled)\n"
+         "  --hum-active S        humidifier active time (default 0)\n"
+         "  --kp K                heater PID gains (default firmware gains;\n"
+         "  --ki K                 --kp 0 --ki 0 is on/off control)\n"
+         "  --kd K\n"
+         "  --window S            heater window (default %u)\n"
+         "  --ambient C           (default 20)\n"
+         "  --ambient-hum RH      (default 60)\n"
+         "  --box-loss K          (default 0.001225)\n"
+         "  --box-capacity J/K    (default 2000)\n"
+         "  --heater-power W      (default 50)\n"
+         "  --water-capacity J/K  (default 4186)\n"
+         "  --fogger-rate G/S     (default 0.002)\n"
+         "  --air-exchange 1/S    (default 0.0005)\n"
+         "  --noise-t C           (default 0.1)\n"
+         "  --noise-h RH          (default 0.5)\n"
+         "  --failure P           DHT read failure probability (default 0.01)\n"
+         "  --spike P             probability of a garbage read that passed the\n"
+         "                        checksum (default 0)\n"
+         "  --band C              settling band (default 0.5)\n"
+         "  --step-temp C         change the temperature setpoint to C ...\n"
+         "  --step-at H           ... H hours into the run\n"
+         "  --seed N              (default 1)\n"
+         "  --csv FILE            write a trace\n"
+         "  --csv-step S          trace period (default 60)\n", name, DEFAULT_HEATER_WINDOW);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  opt.days = 7;
+  opt.step = 1.0;
+  opt.sensorPeriod = 5000;
+  opt.controlPeriod = 5000;
+  opt.band = 0.5;
+  opt.stepAt = 0;
+  opt.stepTemperature = 0;
+  opt.seed = 1;
+  opt.csv = NULL;
+  opt.csvStep = 60;
+
+  ChamberParams params;
+  defaultChamberParams(params);
+
+  SystemData data;
+  defaultSystemData(data);
+  data.state = 1;
+  data.setTemperature = 250;
+  data.setHumidity = 850;
+  data.startEpochTime = START_EPOCH;
+
+  static const struct option longOptions[] = {
+    {"days",           required_argument, 0, 'd'},
+    {"step",           required_argument, 0, 's'},
+    {"sensor-period",  required_argument, 0, 'S'},
+    {"control-period", required_argument, 0, 'C'},
+    {"set-temp",       required_argument, 0, 't'},
+    {"set-hum",        required_argument, 0, 'h'},
+    {"set-vpd",        required_argument, 0, 'v'},
+    {"hum-period",     required_argument, 0, 'p'},
+    {"hum-active",     required_argument, 0, 'a'},
+    {"kp",             required_argument, 0, 'K'},
+    {"ki",             required_argument, 0, 'I'},
+    {"kd",             required_argument, 0, 'D'},
+    {"window",         required_argument, 0, 'W'},
+    {"ambient",        required_argument, 0, 'A'},
+    {"ambient-hum",    required_argument, 0, 'H'},
+    {"box-loss",       required_argument, 0, 'k'},
+    {"box-capacity",   required_argument, 0, 'c'},
+    {"heater-power",   required_argument, 0, 'P'},
+    {"water-capacity", required_argument, 0, 'w'},
+    {"fogger-rate",    required_argument, 0, 'f'},
+    {"air-exchange",   required_argument, 0, 'x'},
+    {"noise-t",        required_argument, 0, 'n'},
+    {"noise-h",        required_argument, 0, 'N'},
+    {"failure",        required_argument, 0, 'F'},
+    {"spike",          required_argument, 0, 'X'},
+    {"band",           required_argument, 0, 'b'},
+    {"step-temp",      required_argument, 0, 'T'},
+    {"step-at",        required_argument, 0, 'B'},
+    {"seed",           required_argument, 0, 'r'},
+    {"csv",            required_argument, 0, 'o'},
+    {"csv-step",       required_argument, 0, 'O'},
+    {"help",           no_argument,       0, '?'},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "", longOptions, NULL)) != -1) {
+    switch (c) {
+      case 'd': opt.days = atof(optarg); break;
+      case 's': opt.step = atof(optarg); break;
+      case 'S': opt.sensorPeriod = atoi(optarg); break;
+      case 'C': opt.controlPeriod = atoi(optarg); break;
+      case 't': data.setTemperature = lround(atof(optarg) * 10); break;
+      case 'h': data.setHumidity = lround(atof(optarg) * 10); break;
+      case 'v': data.setVpd = lround(atof(optarg) * 1000); break;
+      case 'p': data.humidifierPeriod = atoi(optarg); break;
+      case 'a': data.humidifierActiveTime = atoi(optarg); break;
+      case 'K': data.heaterKp = atof(optarg); break;
+      case 'I': data.heaterKi = atof(optarg); break;
+      case 'D': data.heaterKd = atof(optarg); break;
+      case 'W': data.heaterWindow = atoi(optarg); break;
+      case 'A': params.ambientTemperature = atof(optarg); break;
+      case 'H': params.ambientHumidity = atof(optarg); break;
+      case 'k': params.boxLoss = atof(optarg); break;
+      case 'c': params.boxCapacity = atof(optarg); break;
+      case 'P': params.heaterPower = atof(optarg); break;
+      case 'w': params.waterCapacity = atof(optarg); break;
+      case 'f': params.foggerRate = atof(optarg); break;
+      case 'x': params.airExchange = atof(optarg); break;
+      case 'n': params.sensorNoiseT = atof(optarg); break;
+      case 'N': params.sensorNoiseH = atof(optarg); break;
+      case 'F': params.sensorFailure = atof(optarg); break;
+      case 'X': params.sensorSpike = atof(optarg); break;
+      case 'b': opt.band = atof(optarg); break;
+      case 'T': opt.stepTemperature = atof(optarg); break;
+      case 'B': opt.stepAt = atof(optarg) * 3600.0; break;
+      case 'r': opt.seed = atoi(optarg); break;
+      case 'o': opt.csv = optarg; break;
+      case 'O': opt.csvStep = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  FILE* csv = NULL;
+  if (opt.csv) {
+    csv = fopen(opt.csv, "w");
+    if (!csv) {
+      perror(opt.csv);
+      return 1;
+    }
+    fprintf(csv, "time,temperature,water,filtered_temperature,humidity,filtered_humidity,heater,humidifier\n");
+  }
+
+  Chamber    chamber(params, opt.seed);
+  Controller controller(data);
+  Actuator   heaterOutput("heater", 0, HEATER_MIN_ON, HEATER_MIN_OFF);
+  Actuator   humidifierOutput("humidifier", 0, HUMIDIFIER_MIN_ON, HUMIDIFIER_MIN_OFF);
+  heaterOutput.begin(0);
+  humidifierOutput.begin(0);
+
+  Stats st;
+  memset(&st, 0, sizeof(st));
+  st.reachedAt = -1;
+  st.minTemperature = st.minHumidity = 1e9;
+  st.maxTemperature = st.maxHumidity = -1e9;
+
+  // Everything runs on a millisecond clock so the firmware periods are
+  // honoured exactly whatever the plant step is.
+  uint64_t end = (uint64_t)(opt.days * 86400.0 * 1000.0);
+  uint64_t stepMs = (uint64_t)(opt.step * 1000.0);
+  if (stepMs == 0)
+    stepMs = 1;
+  uint64_t nextSensor = 0, nextControl = 0, nextCsv = 0;
+  bool heater = false, humidifier = false;
+  uint64_t samples = 0;
+  bool stepped = false;
+  double setpoint = data.setTemperature / 10.0;
+  double initialSetpoint = setpoint;
+  double stepFrom = 0;
+
+  // The statistics above cover the time before the setpoint step, the step
+  // response is reported on its own.
+  for (uint64_t now = 0; now < end; now += stepMs) {
+    if (opt.stepAt > 0 && !stepped && now >= opt.stepAt * 1000.0) {
+      data.setTemperature = lround(opt.stepTemperature * 10);
+      setpoint = data.setTemperature / 10.0;
+      st.stepLastOutOfBand = 0;
+      st.stepOvershoot = 0;
+      stepped = true;
+      stepFrom = controller.temperatureCelsius();
+    }
+
+    if (now >= nextSensor) {
+      int16_t h = chamber.readHumidity();
+      int16_t t = chamber.readTemperature();
+      controller.processSensors((uint32_t)now, t, h);
+      nextSensor += opt.sensorPeriod;
+    }
+
+    if (now >= nextControl) {
+      uint32_t epoch = START_EPOCH + (uint32_t)(now / 1000);
+      bool he = heaterOutput.set(controller.processHeater((uint32_t)now), (uint32_t)now);
+      bool hu = humidifierOutput.set(controller.processHumidifier(epoch), (uint32_t)now);
+      if (he != heater)
+        st.heaterSwitches++;
+      if (hu != humidifier)
+        st.humidifierSwitches++;
+      heater = he;
+      humidifier = hu;
+      nextControl += opt.controlPeriod;
+    }
+
+    chamber.step(stepMs / 1000.0, heater, humidifier);
+
+    double time = now / 1000.0;
+    double dt = stepMs / 1000.0;
+    double t = chamber.temperature();
+    double h = chamber.humidity();
+    if (heater)
+      st.heaterOnTime += dt;
+    if (humidifier)
+      st.humidifierOnTime += dt;
+
+    if (stepped) {
+      double over = (t - setpoint) * (setpoint > stepFrom ? 1 : -1);
+      if (over > st.stepOvershoot)
+        st.stepOvershoot = over;
+      if (fabs(t - setpoint) > opt.band)
+        st.stepLastOutOfBand = time - opt.stepAt;
+    } else if (st.reachedAt < 0 && t >= setpoint) {
+      st.reachedAt = time;
+    }
+    if (!stepped && st.reachedAt >= 0) {
+      double error = t - setpoint;
+      if (t > st.maxTemperature) st.maxTemperature = t;
+      if (t < st.minTemperature) st.minTemperature = t;
+      if (h > st.maxHumidity) st.maxHumidity = h;
+      if (h < st.minHumidity) st.minHumidity = h;
+      st.sqError += error * error * dt;
+      st.sqErrorTime += dt;
+      st.sumHumidity += h;
+      samples++;
+    }
+    if (!stepped && fabs(t - setpoint) > opt.band)
+      st.lastOutOfBand = time;
+
+    if (csv && now >= nextCsv) {
+      fprintf(csv, "%.0f,%.3f,%.3f,%.2f,%.2f,%.2f,%d,%d\n", time, t, chamber.waterTemperature(),
+              controller.temperatureCelsius(), h, controller.relativeHumidity(), heater, humidifier);
+      nextCsv += (uint64_t)opt.csvStep * 1000;
+    }
+  }
+
+  if (csv)
+    fclose(csv);
+
+  double days = opt.days;
+  printf("simulated          %.2f days\n", days);
+  if (data.setVpd > 0)
+    printf("setpoints          %.1f C, VPD %.2f kPa\n", initialSetpoint, data.setVpd / 1000.0);
+  else
+    printf("setpoints          %.1f C, %.1f %%RH\n", initialSetpoint, data.setHumidity / 10.0);
+  if (data.heaterKp == 0 && data.heaterKi == 0)
+    printf("heater control     on/off\n");
+  else
+    printf("heater control     PID kp %g ki %g kd %g, window %u s\n",
+           data.heaterKp, data.heaterKi, data.heaterKd, data.heaterWindow);
+  double settleEnd = stepped ? opt.stepAt : days * 86400.0;
+  if (st.reachedAt < 0) {
+    printf("temperature        setpoint never reached, final %.2f C\n", chamber.temperature());
+  } else {
+    printf("rise time          %.0f s\n", st.reachedAt);
+    printf("overshoot          %.2f C\n", st.maxTemperature - initialSetpoint);
+    printf("undershoot         %.2f C\n", initialSetpoint - st.minTemperature);
+    printf("rms error          %.3f C\n", sqrt(st.sqError / st.sqErrorTime));
+    if (st.lastOutOfBand < settleEnd - opt.step)
+      printf("settling time      %.0f s (+/-%.2f C)\n", st.lastOutOfBand, opt.band);
+    else
+      printf("settling time      not settled (+/-%.2f C)\n", opt.band);
+    printf("humidity           min %.1f, mean %.1f, max %.1f %%RH\n",
+           st.minHumidity, st.sumHumidity / samples, st.maxHumidity);
+  }
+  if (stepped) {
+    printf("setpoint step      to %.1f C after %.1f h\n", opt.stepTemperature, opt.stepAt / 3600.0);
+    printf("  overshoot        %.2f C\n", st.stepOvershoot);
+    if (st.stepLastOutOfBand < days * 86400.0 - opt.stepAt - opt.step)
+      printf("  settling time    %.0f s (+/-%.2f C)\n", st.stepLastOutOfBand, opt.band);
+    else
+      printf("  settling time    not settled (+/-%.2f C)\n", opt.band);
+  }
+  if (controller.model.identified())
+    printf("thermal model      tau %.0f s, heater gain %.1f C +/-%.0f %%, ambient %.1f C (%u updates)\n",
+           controller.model.timeConstant(), controller.model.heaterGain(),
+           100 * controller.model.gainError(), controller.model.ambient(), controller.model.updates);
+  else if (controller.model.valid())
+    printf("thermal model      not identified, temperature spread %.2f C (%u updates)\n",
+           controller.model.spread(), controller.model.updates);
+  else
+    printf("thermal model      not valid (%u updates)\n", controller.model.updates);
+  printf("heater             %u switches (%.1f/day), duty %.1f %%\n", st.heaterSwitches,
+         st.heaterSwitches / days, 100.0 * st.heaterOnTime / (days * 86400.0));
+  printf("humidifier         %u switches (%.1f/day), duty %.1f %%\n", st.humidifierSwitches,
+         st.humidifierSwitches / days, 100.0 * st.humidifierOnTime / (days * 86400.0));
+
+  return 0;
+}